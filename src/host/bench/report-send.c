@@ -0,0 +1,138 @@
+/* ----------------------------------------------------------------------------
+ * host benchmark : loop passes per second, with and without report gating
+ *
+ * - Runs idle passes of the main loop (debouncing, queueing changes, the
+ *   (empty) key queue, and sending the reports), with the real USB library
+ *   (not the host stand-in), and times them
+ *     - gated: the keyboard report is only sent when
+ *       `keyboard_report_changed` is set (as "../../main.c" does)
+ *     - every pass: the keyboard report is sent on every pass (as the main
+ *       loop used to)
+ * - The USB registers are plain variables, and the endpoint always has room
+ *   (every report is written to it straight away), so this is the time it
+ *   takes to queue and write the reports, and nothing else.  On the
+ *   keyboard, the old `usb_keyboard_send()` also waited (with interrupts
+ *   off) for the host to take the last report, which can't be measured
+ *   here.
+ * - `kb_update_matrix()` (which reads stdin, in the host build) and the
+ *   LEDs are left out of both.
+ * - Times are in host nanoseconds, so they're only good for comparing the
+ *   two with each other (see "../readme.md").
+ * - Built with the rest of the host build (except "../../main.c", which is
+ *   included here, with its `main()` renamed, and "../usb_keyboard.c", which
+ *   the real library replaces), and run by `make host-bench`.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// ----------------------------------------------------------------------------
+
+// the registers (and bits) the library touches (see
+// "../check/usb-poll-interval.c")
+// - the endpoint always has room: `RWAL` is set in `UEINTX`, and stays set
+//   when the library writes 0x3A to it after each report
+static volatile uint8_t
+	PLLCSR, UHWCON, USBCON, UDCON, UDADDR, UDIEN, UDINT, UDFNUML,
+	UECFG0X, UECFG1X, UECONX, UEDATX, UEIENX, UEINTX = 0xFF, UENUM, UERST;
+
+#define  ADDEN     7
+#define  EORSTE    3
+#define  EORSTI    3
+#define  EPEN      0
+#define  FRZCLK    5
+#define  OTGPADE   4
+#define  PLOCK     0
+#define  RSTDT     3
+#define  RWAL      5
+#define  RXOUTI    2
+#define  RXSTPE    3
+#define  RXSTPI    3
+#define  SOFE      2
+#define  SOFI      2
+#define  STALLRQ   5
+#define  STALLRQC  4
+#define  TXINI     0
+#define  USBE      7
+
+#define  ISR(vector)  static void __attribute__((unused)) vector(void)
+
+// (see "../check/usb-poll-interval.c")
+#define  int16_t  uint16_t
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+
+#include "../../lib-other/pjrc/usb_keyboard/usb_keyboard.c"
+
+#undef int16_t
+
+#define main firmware_main
+#include "../../main.c"
+#undef main
+
+// ----------------------------------------------------------------------------
+
+#define PASSES  10000000
+
+// ----------------------------------------------------------------------------
+
+/* run `PASSES` idle passes of the main loop
+ *
+ * arguments
+ * - `gated`: whether to send the keyboard report only when it's changed
+ *
+ * returns
+ * - the time taken, in ns
+ */
+static uint64_t _run(bool gated) {
+	struct key_queue_entry entry;
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t pass=0; pass<PASSES; pass++) {
+		debounce_update(main_kb_raw, main_kb_is_pressed, 1);
+		main_queue_changes();
+		while (! key_queue_pop(&entry));
+
+		if (! gated || keyboard_report_changed)
+			usb_keyboard_send();
+		usb_extra_consumer_send();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000
+	     + (end.tv_nsec - start.tv_nsec);
+}
+
+// ----------------------------------------------------------------------------
+
+int main(void) {
+	usb_configuration = 1;  // (as if the host had enumerated us)
+
+	printf("# idle main loop passes (host), with the real USB library\n");
+	printf("%-12s %12s %8s\n", "# send", "passes/s", "ns/pass");
+
+	static const struct {
+		const char * name;
+		bool         gated;
+	} runs[] = {
+		{ "gated",      true  },
+		{ "every-pass", false },
+	};
+
+	for (uint8_t i=0; i<sizeof(runs)/sizeof(runs[0]); i++) {
+		uint64_t ns = _run(runs[i].gated);
+		printf( "%-12s %12.0f %8.2f\n",
+		        runs[i].name,
+		        (double)PASSES * 1000000000 / ns,
+		        (double)ns / PASSES );
+	}
+
+	return 0;
+}
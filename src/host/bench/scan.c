@@ -0,0 +1,144 @@
+/* ----------------------------------------------------------------------------
+ * host benchmark : change detection, per idle scan and per changed scan
+ *
+ * - Times `main_queue_changes()` in "../../main.c" (one `uint16_t` per row,
+ *   compared with XOR, only the set bits walked) against the loop it
+ *   replaced (below, as a reference: every cell of a `bool` matrix compared
+ *   on every scan), over
+ *     - idle scans: nothing changes
+ *     - changed scans: one (random) key changes every scan
+ * - Each scan also flips the key (for changed scans) and empties the key
+ *   queue.  That costs the same for both, so it's timed on its own (with no
+ *   change detection at all), and taken out of the numbers printed.
+ * - Times are in host nanoseconds, so they're only good for comparing the
+ *   two with each other (see "../readme.md").
+ * - Built with the rest of the host build (except "../../main.c", which is
+ *   included here, with its `main()` renamed), and run by `make host-bench`.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define main firmware_main
+#include "../../main.c"
+#undef main
+
+// ----------------------------------------------------------------------------
+
+#define SCANS  10000000
+
+// ----------------------------------------------------------------------------
+// reference: the old change detection
+// ----------------------------------------------------------------------------
+
+static bool ref_is_pressed[KB_ROWS][KB_COLUMNS];
+static bool ref_queued[KB_ROWS][KB_COLUMNS];
+
+static void ref_queue_changes(void) {
+	for (uint8_t row=0; row<KB_ROWS; row++) {
+		for (uint8_t col=0; col<KB_COLUMNS; col++) {
+			bool is_pressed = ref_is_pressed[row][col];
+
+			if (is_pressed != ref_queued[row][col]) {
+				struct key_queue_entry entry = {
+					.row        = row,
+					.col        = col,
+					.is_pressed = is_pressed,
+					.time       = main_scan_tick,
+				};
+
+				if (key_queue_push(&entry))
+					return;  // full
+				ref_queued[row][col] = is_pressed;
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// a small PRNG (xorshift32), so runs are the same everywhere
+static uint32_t _random_state;
+static uint32_t _random(uint32_t n) {
+	_random_state ^= _random_state << 13;
+	_random_state ^= _random_state >> 17;
+	_random_state ^= _random_state << 5;
+	return _random_state % n;
+}
+
+enum method { NONE, BIT_ROWS, BOOL_MATRIX };
+
+/* run `SCANS` scans
+ *
+ * arguments
+ * - `method`: which change detection to use
+ * - `change`: whether to flip a key before each scan
+ *
+ * returns
+ * - the time taken, in ns
+ */
+static uint64_t _run(enum method method, bool change) {
+	struct key_queue_entry entry;
+	struct timespec start, end;
+
+	// start with nothing left to queue, and the same keys each time
+	memcpy(main_kb_queued, main_kb_is_pressed, sizeof(main_kb_queued));
+	memcpy(ref_queued, ref_is_pressed, sizeof(ref_queued));
+	_random_state = 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t scan=0; scan<SCANS; scan++) {
+		if (change) {
+			uint8_t row = _random(KB_ROWS);
+			uint8_t col = _random(KB_COLUMNS);
+			main_kb_is_pressed[row] ^= (1<<col);
+			ref_is_pressed[row][col] = ! ref_is_pressed[row][col];
+		}
+
+		if (method == BIT_ROWS)
+			main_queue_changes();
+		else if (method == BOOL_MATRIX)
+			ref_queue_changes();
+
+		while (! key_queue_pop(&entry));
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000
+	     + (end.tv_nsec - start.tv_nsec);
+}
+
+/* the time per scan taken by `method` (less the time taken by the rest of
+ * the loop), in ns
+ */
+static double _per_scan(enum method method, bool change) {
+	uint64_t overhead = _run(NONE, change);
+	uint64_t total    = _run(method, change);
+
+	return (total > overhead) ? (double)(total - overhead) / SCANS : 0;
+}
+
+// ----------------------------------------------------------------------------
+
+int main(void) {
+	printf("# ns per scan (host), change detection only\n");
+	printf("%-12s %8s %8s\n", "# method", "idle", "changed");
+
+	double bit_idle     = _per_scan(BIT_ROWS, false);
+	double bit_changed  = _per_scan(BIT_ROWS, true);
+	printf("%-12s %8.2f %8.2f\n", "bit-rows", bit_idle, bit_changed);
+
+	double bool_idle    = _per_scan(BOOL_MATRIX, false);
+	double bool_changed = _per_scan(BOOL_MATRIX, true);
+	printf("%-12s %8.2f %8.2f\n", "bool-matrix", bool_idle, bool_changed);
+
+	return 0;
+}
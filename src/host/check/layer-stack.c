@@ -0,0 +1,197 @@
+/* ----------------------------------------------------------------------------
+ * host check : the layer stack, against the old implementation
+ *
+ * - Drives the layer stack in "../../main.c" (a table of elements indexed by
+ *   id, linked into a stack) and the array based stack it replaced (below,
+ *   as a reference) with the same random pushes and pops, and after each
+ *   one checks that every query gives the same answer from both.
+ * - The reference is the old code, except that `pop_id()` also moves
+ *   `sticky` down with the rest of each element (the old code left it
+ *   behind, which was a bug).
+ * - Built with the rest of the host build (except "../../main.c", which is
+ *   included here, with its `main()` renamed), and run by `make host-check`.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define main firmware_main
+#include "../../main.c"
+#undef main
+
+// ----------------------------------------------------------------------------
+
+#define ITERATIONS  1000000
+#define MAX_OFFSET  (MAX_ACTIVE_LAYERS + 2)  // (a little out of bounds too)
+
+// ----------------------------------------------------------------------------
+// reference: the old layer stack
+// ----------------------------------------------------------------------------
+
+static struct {
+	uint8_t layer;
+	uint8_t id;
+	uint8_t sticky;
+} ref_layers[MAX_ACTIVE_LAYERS];
+static uint8_t ref_layers_head = 0;
+static bool    ref_layers_ids_in_use[MAX_ACTIVE_LAYERS] = {true};
+
+static uint8_t ref_peek(uint8_t offset) {
+	if (offset <= ref_layers_head)
+		return ref_layers[ref_layers_head - offset].layer;
+
+	return 0;  // default, or error
+}
+
+static uint8_t ref_peek_sticky(uint8_t offset) {
+	if (offset <= ref_layers_head)
+		return ref_layers[ref_layers_head - offset].sticky;
+
+	return 0;  // default, or error
+}
+
+static uint8_t ref_peek_id(uint8_t offset) {
+	if (offset <= ref_layers_head)
+		return ref_layers[ref_layers_head - offset].id;
+
+	return 0;  // default, or error
+}
+
+static uint8_t ref_push(uint8_t layer, uint8_t sticky) {
+	for (uint8_t id=1; id<MAX_ACTIVE_LAYERS; id++) {
+		if (ref_layers_ids_in_use[id] == false) {
+			ref_layers_ids_in_use[id] = true;
+			ref_layers_head++;
+			ref_layers[ref_layers_head].layer = layer;
+			ref_layers[ref_layers_head].id = id;
+			ref_layers[ref_layers_head].sticky = sticky;
+			return id;
+		}
+	}
+
+	return 0;  // default, or error
+}
+
+static void ref_pop_id(uint8_t id) {
+	for (uint8_t element=1; element<=ref_layers_head; element++) {
+		if (ref_layers[element].id == id) {
+			for(; element<ref_layers_head; ++element)
+				ref_layers[element] = ref_layers[element+1];
+			ref_layers[ref_layers_head].layer = 0;
+			ref_layers[ref_layers_head].id = 0;
+			ref_layers[ref_layers_head].sticky = 0;
+			ref_layers_ids_in_use[id] = false;
+			ref_layers_head--;
+			return;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// a small PRNG (xorshift32), so runs are the same everywhere
+static uint32_t _random_state = 1;
+static uint32_t _random(uint32_t n) {
+	_random_state ^= _random_state << 13;
+	_random_state ^= _random_state >> 17;
+	_random_state ^= _random_state << 5;
+	return _random_state % n;
+}
+
+static uint32_t _iteration;
+static const char * _operation;
+
+static bool _fail(const char * what, uint8_t offset, int got, int expected) {
+	fprintf( stderr,
+	         "error: iteration %lu (after %s): %s(%u) is %d, expected %d\n",
+	         (unsigned long)_iteration, _operation,
+	         what, offset, got, expected );
+	return false;
+}
+
+/* compare everything that can be asked of the two stacks
+ *
+ * returns
+ * - true if they agree
+ */
+static bool _compare(void) {
+	for (uint8_t offset=0; offset<MAX_OFFSET; offset++) {
+		if (main_layers_peek(offset) != ref_peek(offset))
+			return _fail( "peek", offset,
+			              main_layers_peek(offset), ref_peek(offset) );
+		if (main_layers_peek_sticky(offset) != ref_peek_sticky(offset))
+			return _fail( "peek_sticky", offset,
+			              main_layers_peek_sticky(offset),
+			              ref_peek_sticky(offset) );
+		if (main_layers_peek_id(offset) != ref_peek_id(offset))
+			return _fail( "peek_id", offset,
+			              main_layers_peek_id(offset),
+			              ref_peek_id(offset) );
+	}
+
+	// walking down from the top, one `below()` at a time, visits the same
+	// elements as peeking at each offset (and stays on the base)
+	uint8_t id = main_layers_peek_id(0);
+	for (uint8_t offset=0; offset<MAX_OFFSET; offset++) {
+		uint8_t expected = (offset <= ref_layers_head)
+		                   ? ref_peek_id(offset) : 0;
+		if (id != expected)
+			return _fail("below() chain", offset, id, expected);
+		if (main_layers_get_layer(id) != ref_peek(offset))
+			return _fail( "get_layer(below() chain)", offset,
+			              main_layers_get_layer(id),
+			              ref_peek(offset) );
+		id = main_layers_below(id);
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+int main(void) {
+	for (_iteration=0; _iteration<ITERATIONS; _iteration++) {
+		uint32_t choice = _random(100);
+
+		if (choice < 45) {
+			_operation = "push";
+			uint8_t layer  = _random(KB_LAYERS);
+			uint8_t sticky = _random(4);  // (see `StickyState`)
+			uint8_t id     = main_layers_push(layer, sticky);
+			uint8_t ref_id = ref_push(layer, sticky);
+			if (id != ref_id) {
+				_fail("push", layer, id, ref_id);
+				return 1;
+			}
+		} else if (choice < 90) {
+			// any id, including ones not in use, 0, and out of range
+			_operation = "pop_id";
+			uint8_t id = _random(MAX_OFFSET);
+			main_layers_pop_id(id);
+			ref_pop_id(id);
+		} else if (choice < 98) {
+			_operation = "pop_id(top)";
+			uint8_t id = ref_peek_id(0);
+			main_layers_pop_id(id);
+			ref_pop_id(id);
+		} else {
+			_operation = "pop_id(everything)";
+			for (uint8_t id=0; id<MAX_OFFSET; id++) {
+				main_layers_pop_id(id);
+				ref_pop_id(id);
+			}
+		}
+
+		if (! _compare())
+			return 1;
+	}
+
+	return 0;
+}
+
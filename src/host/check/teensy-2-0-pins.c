@@ -0,0 +1,216 @@
+/* ----------------------------------------------------------------------------
+ * host check : the Teensy 2.0 pin masks
+ *
+ * - Checks the macros in "../../keyboard/ergodox/controller/teensy-2-0--pins.h"
+ *   against a naive reference, for every placement of the pins.  Here the
+ *   pin macros give the port and pin number as variables (instead of
+ *   constants), so one build can try every placement.
+ * - `rows_from_port()`: every way of putting the 6 rows on the 8 pins of one
+ *   port, with every value read from the port.
+ * - `UNUSED_MASK()`, `ROW_MASK()`, `COLUMN_MASK()`: every way of dividing the
+ *   18 movable pins (see "teensy-2-0.c") into 5 unused, 6 rows, and 7
+ *   columns, for every port.  (The order of the pins within each group
+ *   doesn't change the masks.)
+ * - Built and run by `make host-check`.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../../keyboard/ergodox/controller/teensy-2-0--pins.h"
+
+// ----------------------------------------------------------------------------
+
+#define UNUSED_COUNT  5
+#define ROW_COUNT     6
+#define COLUMN_COUNT  7
+#define PIN_COUNT     (UNUSED_COUNT + ROW_COUNT + COLUMN_COUNT)
+
+// the movable pins (in "teensy-2-0.c"), as `_PORT_...` and pin number
+static const uint8_t pin_port[PIN_COUNT] = {
+	_PORT_C, _PORT_D, _PORT_D, _PORT_D, _PORT_E,           // unused
+	_PORT_F, _PORT_F, _PORT_F, _PORT_F, _PORT_F, _PORT_F,  // rows
+	_PORT_B, _PORT_B, _PORT_B, _PORT_B, _PORT_D, _PORT_D,  // columns
+	_PORT_C,
+};
+static const uint8_t pin_number[PIN_COUNT] = {
+	7, 7, 4, 5, 6,
+	7, 6, 5, 4, 1, 0,
+	0, 1, 2, 3, 2, 3,
+	6,
+};
+
+// the current placement
+static uint8_t unused_port[UNUSED_COUNT], unused_number[UNUSED_COUNT];
+static uint8_t row_port[ROW_COUNT],       row_number[ROW_COUNT];
+static uint8_t column_port[COLUMN_COUNT], column_number[COLUMN_COUNT];
+
+#define  _PORT_U0  (unused_port[0])
+#define  _PORT_U1  (unused_port[1])
+#define  _PORT_U2  (unused_port[2])
+#define  _PORT_U3  (unused_port[3])
+#define  _PORT_U4  (unused_port[4])
+#define  UNUSED_0  U0, (unused_number[0])
+#define  UNUSED_1  U1, (unused_number[1])
+#define  UNUSED_2  U2, (unused_number[2])
+#define  UNUSED_3  U3, (unused_number[3])
+#define  UNUSED_4  U4, (unused_number[4])
+
+#define  _PORT_R0  (row_port[0])
+#define  _PORT_R1  (row_port[1])
+#define  _PORT_R2  (row_port[2])
+#define  _PORT_R3  (row_port[3])
+#define  _PORT_R4  (row_port[4])
+#define  _PORT_R5  (row_port[5])
+#define  ROW_0  R0, (row_number[0])
+#define  ROW_1  R1, (row_number[1])
+#define  ROW_2  R2, (row_number[2])
+#define  ROW_3  R3, (row_number[3])
+#define  ROW_4  R4, (row_number[4])
+#define  ROW_5  R5, (row_number[5])
+
+#define  _PORT_C7  (column_port[0])
+#define  _PORT_C8  (column_port[1])
+#define  _PORT_C9  (column_port[2])
+#define  _PORT_CA  (column_port[3])
+#define  _PORT_CB  (column_port[4])
+#define  _PORT_CC  (column_port[5])
+#define  _PORT_CD  (column_port[6])
+#define  COLUMN_7  C7, (column_number[0])
+#define  COLUMN_8  C8, (column_number[1])
+#define  COLUMN_9  C9, (column_number[2])
+#define  COLUMN_A  CA, (column_number[3])
+#define  COLUMN_B  CB, (column_number[4])
+#define  COLUMN_C  CC, (column_number[5])
+#define  COLUMN_D  CD, (column_number[6])
+
+static uint32_t _errors;
+
+// ----------------------------------------------------------------------------
+
+static uint8_t naive_mask( uint8_t port, uint8_t count,
+                           const uint8_t * ports, const uint8_t * numbers ) {
+	uint8_t mask = 0;
+	for (uint8_t i=0; i<count; i++)
+		if (ports[i] == port)
+			mask |= 1 << numbers[i];
+	return mask;
+}
+
+static void check_masks(void) {
+	static const char name[] = "?BCDEF";
+
+	const uint8_t masks[3][5] = {
+		{ UNUSED_MASK(B), UNUSED_MASK(C), UNUSED_MASK(D),
+		  UNUSED_MASK(E), UNUSED_MASK(F) },
+		{ ROW_MASK(B), ROW_MASK(C), ROW_MASK(D),
+		  ROW_MASK(E), ROW_MASK(F) },
+		{ COLUMN_MASK(B), COLUMN_MASK(C), COLUMN_MASK(D),
+		  COLUMN_MASK(E), COLUMN_MASK(F) },
+	};
+
+	for (uint8_t port=_PORT_B; port<=_PORT_F; port++) {
+		const uint8_t expected[3] = {
+			naive_mask( port, UNUSED_COUNT,
+			            unused_port, unused_number ),
+			naive_mask( port, ROW_COUNT,
+			            row_port, row_number ),
+			naive_mask( port, COLUMN_COUNT,
+			            column_port, column_number ),
+		};
+
+		for (uint8_t set=0; set<3; set++) {
+			if (masks[set][port-_PORT_B] == expected[set])
+				continue;
+			if (_errors++ < 10)
+				fprintf( stderr,
+				         "error: %s_MASK(%c) is 0x%02X, "
+				         "expected 0x%02X\n",
+				         (const char *[]){"UNUSED","ROW","COLUMN"}[set],
+				         name[port],
+				         masks[set][port-_PORT_B],
+				         expected[set] );
+		}
+	}
+}
+
+/* every division of the movable pins into unused, rows, and columns
+ * - `pin`: the next pin to place
+ * - `u`, `r`, `c`: how many pins are in each group so far
+ */
+static void place(uint8_t pin, uint8_t u, uint8_t r, uint8_t c) {
+	if (pin == PIN_COUNT) {
+		check_masks();
+		return;
+	}
+
+	if (u < UNUSED_COUNT) {
+		unused_port[u] = pin_port[pin];
+		unused_number[u] = pin_number[pin];
+		place(pin+1, u+1, r, c);
+	}
+	if (r < ROW_COUNT) {
+		row_port[r] = pin_port[pin];
+		row_number[r] = pin_number[pin];
+		place(pin+1, u, r+1, c);
+	}
+	if (c < COLUMN_COUNT) {
+		column_port[c] = pin_port[pin];
+		column_number[c] = pin_number[pin];
+		place(pin+1, u, r, c+1);
+	}
+}
+
+/* every way of putting the rows on the pins of one port (each row on a
+ * different pin)
+ * - `row`: the next row to place
+ * - `used`: the pins already taken
+ */
+static void place_rows(uint8_t row, uint8_t used) {
+	if (row == ROW_COUNT) {
+		for (uint16_t pins=0; pins<=0xFF; pins++) {
+			uint8_t expected = 0;
+			for (uint8_t r=0; r<ROW_COUNT; r++)
+				if (pins & (1 << row_number[r]))
+					expected |= 1 << r;
+
+			uint8_t rows = rows_from_port(pins);
+			if (rows != expected && _errors++ < 10)
+				fprintf( stderr,
+				         "error: rows_from_port(0x%02X) is "
+				         "0x%02X, expected 0x%02X (rows on "
+				         "pins %u %u %u %u %u %u)\n",
+				         pins, rows, expected,
+				         row_number[0], row_number[1],
+				         row_number[2], row_number[3],
+				         row_number[4], row_number[5] );
+		}
+		return;
+	}
+
+	for (uint8_t number=0; number<8; number++) {
+		if (used & (1 << number))
+			continue;
+		row_number[row] = number;
+		place_rows(row+1, used | (1 << number));
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int main(void) {
+	place_rows(0, 0);
+	place(0, 0, 0, 0);
+
+	if (_errors) {
+		fprintf(stderr, "%lu errors\n", (unsigned long)_errors);
+		return 1;
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,105 @@
+/* ----------------------------------------------------------------------------
+ * host check : the USB poll interval in the configuration descriptor
+ *
+ * - Compiles the real USB library (not the host stand-in), with the USB
+ *   registers as plain variables, and checks that every interrupt endpoint
+ *   of the keyboard and extra interfaces asks to be polled every
+ *   `MAKEFILE_USB_POLL_INTERVAL` ms.  The debug interface (if any) always
+ *   asks for 1 ms, and isn't checked.
+ * - Built and run by `make host-check`, once for each interval in
+ *   `HOST_CHECK_USB_POLL_INTERVALS` (see the makefile).
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+// ----------------------------------------------------------------------------
+
+// the registers (and bits) the library touches
+// - their values don't matter here: none of the code using them is run
+// - `SREG` is declared in "../include/avr/io.h" (and defined in
+//   "../hardware.c", for the host build)
+volatile uint8_t SREG;
+static volatile uint8_t
+	PLLCSR, UHWCON, USBCON, UDCON, UDADDR, UDIEN, UDINT, UDFNUML,
+	UECFG0X, UECFG1X, UECONX, UEDATX, UEIENX, UEINTX, UENUM, UERST;
+
+#define  ADDEN     7
+#define  EORSTE    3
+#define  EORSTI    3
+#define  EPEN      0
+#define  FRZCLK    5
+#define  OTGPADE   4
+#define  PLOCK     0
+#define  RSTDT     3
+#define  RWAL      5
+#define  RXOUTI    2
+#define  RXSTPE    3
+#define  RXSTPI    3
+#define  SOFE      2
+#define  SOFI      2
+#define  STALLRQ   5
+#define  STALLRQC  4
+#define  TXINI     0
+#define  USBE      7
+
+#define  ISR(vector)  static void __attribute__((unused)) vector(void)
+
+// string descriptors are `int16_t` arrays initialized from wide strings,
+// which only works where `wchar_t` is 16 bits and signed (as on the AVR);
+// here, `-fshort-wchar` makes it 16 bits and unsigned
+#define  int16_t  uint16_t
+
+// (descriptor addresses are read from program memory as 16 bit words, which
+// doesn't fit a pointer here; that code is never run)
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+
+#include "../../lib-other/pjrc/usb_keyboard/usb_keyboard.c"
+
+#undef int16_t
+
+// ----------------------------------------------------------------------------
+
+int main(void) {
+	uint8_t interface = 0;
+	uint8_t checked = 0;
+
+	// walk the descriptors (each starts with its length, then its type)
+	for (uint16_t i=0; i<sizeof(config1_descriptor);
+	     i += config1_descriptor[i]) {
+		const uint8_t * d = &config1_descriptor[i];
+
+		if (d[0] < 2) {
+			fprintf(stderr, "error: bad descriptor at offset %u\n", i);
+			return 1;
+		}
+
+		if (d[1] == 4)  // interface: remember its number
+			interface = d[2];
+
+		if (d[1] == 5 && interface != DEBUG_INTERFACE) {  // endpoint
+			if (d[6] != MAKEFILE_USB_POLL_INTERVAL) {
+				fprintf( stderr,
+				         "error: endpoint 0x%02X: bInterval is %u, "
+				         "expected %u\n",
+				         d[2], d[6], MAKEFILE_USB_POLL_INTERVAL );
+				return 1;
+			}
+			checked++;
+		}
+	}
+
+	// the keyboard and extra interfaces have one endpoint each
+	if (checked != 2) {
+		fprintf(stderr, "error: found %u endpoints, expected 2\n", checked);
+		return 1;
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,255 @@
+/* ----------------------------------------------------------------------------
+ * host build : controller replacement (matrix frames and events in)
+ *
+ * - Each call to `kb_update_matrix()` is one frame (one scan).  The matrix
+ *   for each frame comes from stdin, either as whole frames, or as a trace of
+ *   timestamped key events.  See "./readme.md" for the format.
+ * - At the end of input, the program exits (successfully).
+ * - If the environment variable `HOST_STATS` is set, some statistics
+ *   (including how long the scan loop took per event) are printed to stderr
+ *   on exit.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../keyboard/matrix.h"
+#include "../keyboard/controller.h"
+#include "../lib/key-queue.h"
+#include "../main.h"
+#include "./host.h"
+
+// ----------------------------------------------------------------------------
+
+#define LINE_LENGTH 256
+
+// ----------------------------------------------------------------------------
+
+uint32_t host_frame;  // number of the frame being processed (from 0)
+
+static uint16_t _matrix[KB_ROWS];  // the current state of the matrix
+static uint32_t _hold;             // how many more frames to keep it for
+static uint32_t _line;             // input line number (for error messages)
+
+// the line read but not yet used (an event for a later frame)
+static struct {
+	bool     valid;
+	bool     is_frame;
+	uint32_t repeat;           // frame: how many frames to keep it for
+	uint16_t frame[KB_ROWS];   // frame: the matrix
+	uint32_t time;             // event: the frame to apply it at
+	bool     has_key;          // event: `false` if it's only a time
+	bool     is_pressed;       // event: press or release
+	uint8_t  row;              // event: which key
+	uint8_t  column;           // event: ...
+} _next;
+
+// statistics
+static uint32_t _events;        // number of key state changes in the input
+static uint64_t _loop_ns;       // time spent outside `kb_update_matrix()`
+static struct timespec _return_time;
+
+// ----------------------------------------------------------------------------
+
+static uint64_t _ns_since(struct timespec * start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000
+	     + (now.tv_nsec - start->tv_nsec);
+}
+
+static void _print_stats(void) {
+	if (! getenv("HOST_STATS"))
+		return;
+
+	// we always exit from `kb_update_matrix()`, before scanning the
+	// current frame
+	uint32_t frames = host_frame;
+	fprintf( stderr,
+	         "frames: %lu\n"
+	         "events: %lu\n"
+	         "loop time: %llu ns (%llu ns/frame, %llu ns/event)\n",
+	         (unsigned long)frames,
+	         (unsigned long)_events,
+	         (unsigned long long)_loop_ns,
+	         (unsigned long long)(frames ? _loop_ns / frames : 0),
+	         (unsigned long long)(_events ? _loop_ns / _events : 0) );
+
+	fprintf( stderr,
+	         "key queue: %u deep at most, %u pushes refused\n",
+	         key_queue_high_water,
+	         key_queue_drops );
+
+	#if MAKEFILE_KEY_CACHE
+		// (the counters wrap at 2^16)
+		fprintf( stderr,
+		         "key cache: %u hits, %u misses\n",
+		         main_key_cache_hits,
+		         main_key_cache_misses );
+	#endif
+}
+
+/* returns
+ * - success: 1 (a line was read into `_next`)
+ * - end of input: 0
+ * - a malformed line is reported, and the program exits with an error
+ */
+static uint8_t _read_line(void) {
+	char buffer[LINE_LENGTH];
+
+	while (fgets(buffer, sizeof(buffer), stdin)) {
+		_line++;
+
+		char * s = buffer;
+		char * end;
+
+		// strip comments, and skip empty lines
+		char * comment = strchr(s, '#');
+		if (comment)
+			*comment = '\0';
+		s += strspn(s, " \t\r\n");
+		if (*s == '\0')
+			continue;
+
+		if (*s == '@') {
+			// event: `@<time> [<p|r> <row> <column>]`
+			_next.is_frame = false;
+			_next.time = strtoul(s+1, &end, 10);
+			if (end == s+1)
+				goto error;
+			s = end + strspn(end, " \t\r\n");
+
+			_next.has_key = (*s != '\0');
+			if (_next.has_key) {
+				if (*s != 'p' && *s != 'r')
+					goto error;
+				_next.is_pressed = (*s == 'p');
+				s++;
+
+				unsigned long row = strtoul(s, &end, 16);
+				if (end == s || row >= KB_ROWS)
+					goto error;
+				s = end;
+				unsigned long column = strtoul(s, &end, 16);
+				if (end == s || column >= KB_COLUMNS)
+					goto error;
+				s = end;
+
+				_next.row = row;
+				_next.column = column;
+			}
+		} else {
+			// frame: `[x<count>] <row 0> ... <row KB_ROWS-1>`
+			_next.is_frame = true;
+			_next.repeat = 1;
+			if (*s == 'x') {
+				_next.repeat = strtoul(s+1, &end, 10);
+				if (end == s+1 || ! _next.repeat)
+					goto error;
+				s = end;
+			}
+
+			for (uint8_t row=0; row<KB_ROWS; row++) {
+				unsigned long value = strtoul(s, &end, 16);
+				if (end == s || value >> KB_COLUMNS)
+					goto error;
+				_next.frame[row] = value;
+				s = end;
+			}
+		}
+
+		s += strspn(s, " \t\r\n");
+		if (*s != '\0')
+			goto error;
+
+		_next.valid = true;
+		return 1;  // success
+	}
+
+	return 0;  // end of input
+
+error:
+	fprintf(stderr, "error: line %lu: malformed line\n",
+			(unsigned long)_line);
+	exit(1);
+}
+
+/* sets `_matrix[row]`, and counts the keys that changed as events */
+static void _set_row(uint8_t row, uint16_t value) {
+	_events += __builtin_popcount(_matrix[row] ^ value);
+	_matrix[row] = value;
+}
+
+// ----------------------------------------------------------------------------
+
+/* returns
+ * - success: 0
+ */
+uint8_t kb_init(void) {
+	host_frame = -1;  // so the first frame is frame 0
+	_hold = 0;
+	_line = 0;
+
+	atexit(&_print_stats);
+
+	return 0;  // success
+}
+
+/* returns
+ * - success: 0
+ * - at the end of input, exits (with status 0) instead of returning
+ */
+uint8_t kb_update_matrix(uint16_t matrix[KB_ROWS]) {
+	if (host_frame != (uint32_t)-1)
+		_loop_ns += _ns_since(&_return_time);
+
+	host_frame++;
+
+	if (_hold) {
+		_hold--;
+	} else {
+		for (;;) {
+			if (! _next.valid && ! _read_line())
+				exit(0);
+
+			if (_next.is_frame) {
+				// the matrix for this frame (and maybe some
+				// after)
+				for (uint8_t row=0; row<KB_ROWS; row++)
+					_set_row(row, _next.frame[row]);
+				_hold = _next.repeat - 1;
+				_next.valid = false;
+				break;
+			}
+
+			// an event for a later frame: keep the matrix as it is
+			// until then
+			if (_next.time > host_frame)
+				break;
+
+			if (_next.has_key) {
+				uint16_t bit = (uint16_t)1 << _next.column;
+				uint16_t row = _matrix[_next.row];
+				_set_row( _next.row, (_next.is_pressed)
+				                     ? row | bit
+				                     : row & ~bit );
+			}
+			_next.valid = false;
+		}
+	}
+
+	for (uint8_t row=0; row<KB_ROWS; row++)
+		matrix[row] = _matrix[row];
+
+	clock_gettime(CLOCK_MONOTONIC, &_return_time);
+	return 0;  // success
+}
+
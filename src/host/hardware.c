@@ -0,0 +1,22 @@
+/* ----------------------------------------------------------------------------
+ * host build : stand-ins for the hardware registers
+ *
+ * See "./include/avr/io.h".
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdint.h>
+#include <avr/io.h>
+
+// ----------------------------------------------------------------------------
+
+volatile uint8_t DDRB, DDRC, DDRD, DDRE, DDRF;
+volatile uint8_t PORTB, PORTC, PORTD, PORTE, PORTF;
+volatile uint8_t PINB, PINC, PIND, PINE, PINF;
+volatile uint8_t OCR1A, OCR1B, OCR1C;
+volatile uint8_t SREG;
+
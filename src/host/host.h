@@ -0,0 +1,22 @@
+/* ----------------------------------------------------------------------------
+ * host build : exports
+ *
+ * See "./readme.md".
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef HOST__HOST_h
+	#define HOST__HOST_h
+
+	#include <stdint.h>
+
+	// --------------------------------------------------------------------
+
+	extern uint32_t host_frame;
+
+#endif
+
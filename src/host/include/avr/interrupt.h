@@ -0,0 +1,24 @@
+/* ----------------------------------------------------------------------------
+ * host build : <avr/interrupt.h> replacement
+ *
+ * - Nothing runs in the background on the host, so there's nothing to
+ *   disable.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef HOST__AVR__INTERRUPT_h
+	#define HOST__AVR__INTERRUPT_h
+
+	#include "./io.h"
+
+	// --------------------------------------------------------------------
+
+	#define cli()
+	#define sei()
+
+#endif
+
@@ -0,0 +1,28 @@
+/* ----------------------------------------------------------------------------
+ * host build : <avr/io.h> replacement
+ *
+ * - The I/O registers the core (and the LED macros) touch are plain variables
+ *   here (defined in "../../hardware.c"), so writing to them does nothing,
+ *   and reading them gives back whatever was last written.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef HOST__AVR__IO_h
+	#define HOST__AVR__IO_h
+
+	#include <stdint.h>
+
+	// --------------------------------------------------------------------
+
+	extern volatile uint8_t DDRB, DDRC, DDRD, DDRE, DDRF;
+	extern volatile uint8_t PORTB, PORTC, PORTD, PORTE, PORTF;
+	extern volatile uint8_t PINB, PINC, PIND, PINE, PINF;
+	extern volatile uint8_t OCR1A, OCR1B, OCR1C;
+	extern volatile uint8_t SREG;
+
+#endif
+
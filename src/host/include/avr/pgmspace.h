@@ -0,0 +1,28 @@
+/* ----------------------------------------------------------------------------
+ * host build : <avr/pgmspace.h> replacement
+ *
+ * - On the host, data in "program memory" is just ordinary (constant) data,
+ *   in the same address space as everything else, so reading it is just a
+ *   dereference.
+ * - The `pgm_read_*()` macros keep the type of what they point to, instead of
+ *   returning a fixed size integer: function pointers are stored in the
+ *   layouts and read back with `pgm_read_word()`, and on the host they're
+ *   wider than a word.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef HOST__AVR__PGMSPACE_h
+	#define HOST__AVR__PGMSPACE_h
+
+	#define PROGMEM
+
+	#define pgm_read_byte(address)   (*(address))
+	#define pgm_read_word(address)   (*(address))
+	#define pgm_read_dword(address)  (*(address))
+
+#endif
+
@@ -0,0 +1,20 @@
+/* ----------------------------------------------------------------------------
+ * host build : <util/delay.h> replacement
+ *
+ * - Delays don't do anything on the host: there's no hardware to wait for,
+ *   and runs should be fast and deterministic.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef HOST__UTIL__DELAY_h
+	#define HOST__UTIL__DELAY_h
+
+	#define _delay_ms(ms)  ((void)(ms))
+	#define _delay_us(us)  ((void)(us))
+
+#endif
+
@@ -0,0 +1,95 @@
+/* ----------------------------------------------------------------------------
+ * host build : USB keyboard replacement (HID report frames out)
+ *
+ * - Implements the interface in
+ *   "../lib-other/pjrc/usb_keyboard/usb_keyboard.h", but instead of queueing
+ *   reports for the USB host, prints them to stdout.  See "./readme.md" for
+ *   the format.
+ * - The debug console (if enabled) prints to stderr.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../lib-other/pjrc/usb_keyboard/usb_keyboard.h"
+#include "./host.h"
+
+// ----------------------------------------------------------------------------
+
+uint8_t keyboard_modifier_keys;
+uint8_t keyboard_keys[6];
+uint8_t keyboard_report_changed;
+volatile uint8_t keyboard_leds;
+
+uint16_t consumer_key;
+static uint16_t _last_consumer_key;
+
+// reports are never queued here, so these stay 0
+uint8_t keyboard_queue_overflows;
+uint8_t extra_queue_overflows;
+
+// ----------------------------------------------------------------------------
+
+void usb_init(void) {}
+
+uint8_t usb_configured(void) {
+	return 1;
+}
+
+int8_t usb_keyboard_press(uint8_t key, uint8_t modifier) {
+	int8_t r;
+
+	if (usb_keyboard_room() < 2) return -1;
+	keyboard_modifier_keys = modifier;
+	keyboard_keys[0] = key;
+	r = usb_keyboard_send();
+	if (r) return r;
+	keyboard_modifier_keys = 0;
+	keyboard_keys[0] = 0;
+	return usb_keyboard_send();
+}
+
+// reports are never queued here, so there's always room
+uint8_t usb_keyboard_room(void) {
+	return 255;
+}
+
+int8_t usb_keyboard_send(void) {
+	printf("%lu k %02X 00", (unsigned long)host_frame,
+			keyboard_modifier_keys);
+	for (uint8_t i=0; i<6; i++)
+		printf(" %02X", keyboard_keys[i]);
+	printf("\n");
+
+	keyboard_report_changed = 0;
+	return 0;
+}
+
+#if MAKEFILE_USB_DEBUG
+// debug console output goes to stderr, so it doesn't get mixed up with the
+// reports
+uint8_t debug_buffer_overflows;
+
+int8_t usb_debug_putchar(uint8_t c) {
+	fputc(c, stderr);
+	return 0;
+}
+
+void usb_debug_flush_output(void) {
+	fflush(stderr);
+}
+#endif
+
+int8_t usb_extra_consumer_send(void) {
+	// like the real thing, only send when the key changes
+	if (consumer_key != _last_consumer_key) {
+		printf("%lu c %04X\n", (unsigned long)host_frame, consumer_key);
+		_last_consumer_key = consumer_key;
+	}
+	return 0;
+}
+
@@ -9,12 +9,21 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "./options.h"
 #include "./matrix.h"
 #include "./controller/mcp23018--functions.h"
 #include "./controller/teensy-2-0--functions.h"
 
 // ----------------------------------------------------------------------------
 
+#if KB__IDLE_CHECK
+	// how many more scans to do in full (before going back to checking
+	// whether any keys are pressed first)
+	static uint16_t _full_scans;
+#endif
+
+// ----------------------------------------------------------------------------
+
 /* returns
  * - success: 0
  * - error: number of the function that failed
@@ -32,12 +41,53 @@ uint8_t kb_init(void) {
  * - success: 0
  * - error: number of the function that failed
  */
-uint8_t kb_update_matrix(bool matrix[KB_ROWS][KB_COLUMNS]) {
+uint8_t kb_update_matrix(uint16_t matrix[KB_ROWS]) {
+	uint8_t ret = 0;
+
+	// once per scan, whichever way the scan goes (the i/o expander's probe
+	// interval and backoff are counted in scans)
+	mcp23018_check_connection();
+
+	#if KB__IDLE_CHECK
+		// if no keys have been pressed for a while, check whether any are
+		// now before doing a full scan (see "options.h")
+		if (! _full_scans) {
+			mcp23018_any_key_down_start();
+			bool down = teensy_any_key_down();
+			if (mcp23018_any_key_down_finish())
+				down = true;
+
+			if (! down) {
+				for (uint8_t row=0; row<KB_ROWS; row++)
+					matrix[row] = 0;
+				return 0;  // success
+			}
+		}
+	#endif
+
+	// the left half is read over TWI in the background, while we read the
+	// right half, so this takes about as long as the slower of the two
+	// instead of both together
+	mcp23018_update_matrix_start();
+
 	if (teensy_update_matrix(matrix))
-		return 1;
-	if (mcp23018_update_matrix(matrix))
-		return 2;
+		ret = 1;
+	if (mcp23018_update_matrix_finish(matrix) && !ret)
+		ret = 2;
 
-	return 0;  // success
+	#if KB__IDLE_CHECK
+		// keep doing full scans while keys are being pressed
+		bool down = false;
+		for (uint8_t row=0; row<KB_ROWS; row++)
+			if (matrix[row])
+				down = true;
+
+		if (down)
+			_full_scans = KB__IDLE_HYSTERESIS;
+		else if (_full_scans)
+			_full_scans--;
+	#endif
+
+	return ret;
 }
 
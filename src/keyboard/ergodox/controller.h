@@ -21,7 +21,7 @@
 	// --------------------------------------------------------------------
 
 	uint8_t kb_init(void);
-	uint8_t kb_update_matrix(bool matrix[KB_ROWS][KB_COLUMNS]);
+	uint8_t kb_update_matrix(uint16_t matrix[KB_ROWS]);
 
 #endif
 
@@ -20,8 +20,25 @@
 
 	// --------------------------------------------------------------------
 
+	// error counters (they wrap around; compare them between readings)
+	// - `mcp23018_error_count`: failed scans or init attempts (mostly
+	//   because the i/o expander didn't acknowledge, e.g. it's unplugged)
+	// - `mcp23018_timeout_count`: scans or init attempts where the bus got
+	//   stuck, and had to be recovered
+	// - `mcp23018_reinit_count`: times the i/o expander was initialized
+	//   after the first time (e.g. after being plugged back in)
+	extern uint16_t mcp23018_error_count;
+	extern uint16_t mcp23018_timeout_count;
+	extern uint16_t mcp23018_reinit_count;
+
+	// --------------------------------------------------------------------
+
 	uint8_t mcp23018_init(void);
-	uint8_t mcp23018_update_matrix( bool matrix[KB_ROWS][KB_COLUMNS] );
+	uint8_t mcp23018_check_connection     (void);
+	uint8_t mcp23018_update_matrix_start  (void);
+	uint8_t mcp23018_update_matrix_finish (uint16_t matrix[KB_ROWS]);
+	uint8_t mcp23018_any_key_down_start   (void);
+	bool    mcp23018_any_key_down_finish  (void);
 
 #endif
 
@@ -10,7 +10,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <util/twi.h>
-#include "../../../lib/twi.h"  // `TWI_FREQ` defined in "teensy-2-0.c"
+#include "../../../lib/twi.h"
 #include "../options.h"
 #include "../matrix.h"
 #include "./mcp23018--functions.h"
@@ -28,8 +28,15 @@
 // register addresses (see "mcp23018.md")
 #define IODIRA 0x00  // i/o direction register
 #define IODIRB 0x01
+#define GPINTENA 0x04  // interrupt-on-change control register
+#define GPINTENB 0x05
+#define INTCONA  0x08  // interrupt control register
+#define INTCONB  0x09
+#define IOCON  0x0A  // i/o control register
 #define GPPUA  0x0C  // GPIO pull-up resistor register
 #define GPPUB  0x0D
+#define INTFA  0x0E  // interrupt flag register
+#define INTFB  0x0F
 #define GPIOA  0x12  // general purpose i/o port register (write modifies OLAT)
 #define GPIOB  0x13
 #define OLATA  0x14  // output latch register
@@ -39,6 +46,54 @@
 #define TWI_ADDR_WRITE ( (MCP23018_TWI_ADDRESS<<1) | TW_WRITE )
 #define TWI_ADDR_READ  ( (MCP23018_TWI_ADDRESS<<1) | TW_READ  )
 
+// expected i/o direction register values (see `mcp23018_init()`)
+// - unused  : input  : 1
+// - input   : input  : 1
+// - driving : output : 0
+#if MCP23018__DRIVE_ROWS
+	#define IODIRA_VALUE 0b11111111
+	#define IODIRB_VALUE 0b11000000
+#elif MCP23018__DRIVE_COLUMNS
+	#define IODIRA_VALUE 0b10000000
+	#define IODIRB_VALUE 0b11111111
+#endif
+
+// ----------------------------------------------------------------------------
+
+// connection state
+// - `_initialized`: whether the i/o expander is known to be configured
+// - `_backoff`: how many scans to wait between init attempts, while the i/o
+//   expander isn't responding (doubles after every failed attempt, up to
+//   `MCP23018__BACKOFF_MAX`)
+// - `_countdown`: scans left until the next init attempt (while not
+//   initialized) or liveness probe (while initialized)
+static bool     _initialized;
+static uint16_t _backoff = 1;
+static uint16_t _countdown;
+
+#if MCP23018__INTERRUPT_ON_CHANGE
+	// whether all the columns (or rows) are driven low, no keys were
+	// pressed the last time we looked, and the interrupt state has been
+	// cleared since then; so a key press (on our half) will set INTF
+	static bool _armed;
+#endif
+
+// error counters (see "mcp23018--functions.h")
+uint16_t mcp23018_error_count;
+uint16_t mcp23018_timeout_count;
+uint16_t mcp23018_reinit_count;
+
+// ----------------------------------------------------------------------------
+
+/* count a failed transfer (or group of transfers), given its status
+ */
+static void _count_error(uint8_t status) {
+	if (status == TWI_TIMED_OUT)
+		mcp23018_timeout_count++;
+	else
+		mcp23018_error_count++;
+}
+
 // ----------------------------------------------------------------------------
 
 /* returns:
@@ -52,6 +107,20 @@
 uint8_t mcp23018_init(void) {
 	uint8_t ret;
 
+	// set byte mode (IOCON.BANK = 0, IOCON.SEQOP = 1)
+	// - the address pointer toggles between the A and B registers of a pair
+	//   instead of incrementing, so after writing GPIOA (or GPIOB) it points
+	//   at GPIOB (or GPIOA), and we can read the other port without sending
+	//   the register address again (see `mcp23018_update_matrix_start()`)
+	// - writes and reads of both registers in a pair (as below) still work
+	//   the same way they do in sequential mode
+	twi_start();
+	ret = twi_send(TWI_ADDR_WRITE);
+	if (ret) goto out;  // make sure we got an ACK
+	twi_send(IOCON);
+	twi_send(0b00100000);  // IOCON
+	twi_stop();
+
 	// set pin direction
 	// - unused  : input  : 1
 	// - input   : input  : 1
@@ -60,13 +129,8 @@ uint8_t mcp23018_init(void) {
 	ret = twi_send(TWI_ADDR_WRITE);
 	if (ret) goto out;  // make sure we got an ACK
 	twi_send(IODIRA);
-	#if MCP23018__DRIVE_ROWS
-		twi_send(0b11111111);  // IODIRA
-		twi_send(0b11000000);  // IODIRB
-	#elif MCP23018__DRIVE_COLUMNS
-		twi_send(0b10000000);  // IODIRA
-		twi_send(0b11111111);  // IODIRB
-	#endif
+	twi_send(IODIRA_VALUE);  // IODIRA
+	twi_send(IODIRB_VALUE);  // IODIRB
 	twi_stop();
 
 	// set pull-up
@@ -86,6 +150,34 @@ uint8_t mcp23018_init(void) {
 	#endif
 	twi_stop();
 
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		// set interrupt-on-change
+		// - input   : on  : 1
+		// - others  : off : 0
+		// - compare against the previous value (INTCON = 0), and not
+		//   DEFVAL, so any change sets INTF
+		twi_start();
+		ret = twi_send(TWI_ADDR_WRITE);
+		if (ret) goto out;  // make sure we got an ACK
+		twi_send(GPINTENA);
+		#if MCP23018__DRIVE_ROWS
+			twi_send(0b01111111);  // GPINTENA
+			twi_send(0b00000000);  // GPINTENB
+		#elif MCP23018__DRIVE_COLUMNS
+			twi_send(0b00000000);  // GPINTENA
+			twi_send(0b00111111);  // GPINTENB
+		#endif
+		twi_stop();
+
+		twi_start();
+		ret = twi_send(TWI_ADDR_WRITE);
+		if (ret) goto out;  // make sure we got an ACK
+		twi_send(INTCONA);
+		twi_send(0b00000000);  // INTCONA
+		twi_send(0b00000000);  // INTCONB
+		twi_stop();
+	#endif
+
 	// set logical value (doesn't matter on inputs)
 	// - unused  : hi-Z : 1
 	// - input   : hi-Z : 1
@@ -99,108 +191,391 @@ uint8_t mcp23018_init(void) {
 
 out:
 	twi_stop();
+
+	_initialized = !ret;
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		_armed = false;
+	#endif
+	_countdown = (ret) ? 1 : MCP23018__PROBE_INTERVAL;
 	return ret;
 }
 
 /* returns:
  * - success: 0
- * - failure: twi status code
+ * - failure: twi status code, or 1 if the i/o direction registers don't
+ *   have the values we set (meaning the i/o expander was reset, e.g. by
+ *   being unplugged and plugged back in between scans)
  */
+static uint8_t _probe(void) {
+	uint8_t ret, iodira, iodirb;
+
+	twi_start();
+	ret = twi_send(TWI_ADDR_WRITE);
+	if (ret) goto out;  // make sure we got an ACK
+	twi_send(IODIRA);
+	twi_start();
+	twi_send(TWI_ADDR_READ);
+	twi_read(&iodira);
+	twi_read(&iodirb);
+
+	if (iodira != IODIRA_VALUE || iodirb != IODIRB_VALUE)
+		ret = 1;
+
+out:
+	twi_stop();
+	return ret;
+}
+
+/* make sure the i/o expander is there, and initialized
+ *
+ * returns:
+ * - success: 0
+ * - failure: twi status code, or 1 if we're waiting to try again
+ *
+ * notes:
+ * - must be called exactly once per scan (by `kb_update_matrix()`), before
+ *   any of the `..._start()` functions: the probe interval and the backoff
+ *   are counted in calls to this function
+ * - this is where the i/o expander gets (re)initialized if it needs to be
+ *   (e.g. if it wasn't plugged in during the first init, or was unplugged
+ *   later), so that the scan itself doesn't have to do it every time
+ */
+uint8_t mcp23018_check_connection(void) {
+	uint8_t ret;
+
+	if (_initialized) {
+		// probe occasionally, to catch the i/o expander being reset
+		if (--_countdown)
+			return 0;
+		_countdown = MCP23018__PROBE_INTERVAL;
+		ret = _probe();
+		if (! ret)
+			return 0;
+		if (ret != 1)  // (not just reset)
+			_count_error(ret);
+		_initialized = false;
+		_backoff = 1;
+	} else if (--_countdown) {
+		// still backing off
+		return 1;
+	}
+
+	ret = mcp23018_init();
+	if (ret) {
+		// back off exponentially while the left half is missing
+		_count_error(ret);
+		_countdown = _backoff;
+		if (_backoff < MCP23018__BACKOFF_MAX)
+			_backoff <<= 1;
+	} else {
+		mcp23018_reinit_count++;
+		_backoff = 1;
+	}
+
+	return ret;
+}
+
 #if KB_ROWS != 6 || KB_COLUMNS != 14
 	#error "Expecting different keyboard dimensions"
 #endif
-uint8_t mcp23018_update_matrix(bool matrix[KB_ROWS][KB_COLUMNS]) {
-	uint8_t ret, data;
 
-	// initialize things, just to make sure
-	// - it's not appreciably faster to skip this, and it takes care of the
-	//   case when the i/o expander isn't plugged in during the first
-	//   init()
-	ret = mcp23018_init();
+// the port we drive (one pin at a time), how many pins we strobe, the value
+// that drives all of them at once, and which pins of the other port are
+// inputs
+#if MCP23018__DRIVE_ROWS
+	#define DRIVE_PORT     GPIOB
+	#define STROBES        6
+	#define DRIVE_ALL_LOW  IODIRB_VALUE
+	#define INPUT_MASK     0b01111111  // columns 6..0 (GPIOA)
+	#define INPUT_INTF     INTFA
+#elif MCP23018__DRIVE_COLUMNS
+	#define DRIVE_PORT     GPIOA
+	#define STROBES        7
+	#define DRIVE_ALL_LOW  IODIRA_VALUE
+	#define INPUT_MASK     0b00111111  // rows 0..5 (GPIOB)
+	#define INPUT_INTF     INTFB
+#endif
+#if STROBES+1 > TWI_QUEUE_SIZE
+	#error "The TWI queue is too small for a scan"
+#endif
 
-	// if there was an error
-	if (ret) {
-		// clear our part of the matrix
-		for (uint8_t row=0; row<=5; row++)
-			for (uint8_t col=0; col<=6; col++)
-				matrix[row][col] = 0;
+// the scan, as a list of background transactions
+// - each row (or column) is set and read in a single transaction
+//       S OP W ADDR Din SR OP R Dout P
+//   (the address pointer toggles to the other port after the write, in byte
+//   mode) which is 5 bytes on the bus (plus start, restart, and stop), so a
+//   scan costs
+//       7 columns * 5 bytes  = 35 bytes  (6 rows * 5 = 30, if driving rows)
+//       set all hi-Z         =  3 bytes
+//       total                = 38 bytes  (33)
+//   (at 400kHz, that's about 9 bits per byte, or ~0.9ms per scan)
+// - the last transaction sets all driven pins back to hi-Z
+static uint8_t _strobe[STROBES+1][2];  // register address, value
+static uint8_t _data[STROBES];         // value read from the other port
+static struct twi_transaction _scan[STROBES+1];
 
-		return ret;
+// the idle check, as a single background transaction
+// - drive all the columns (or rows) low at once, and read the other port:
+//   5 bytes on the bus, instead of 38 (or 33) for a full scan
+// - everything is left driven low afterwards; the next full scan will set
+//   each pin the way it needs to be, and then set them all back to hi-Z
+// - reading the other port also clears the interrupt state, so (with
+//   `MCP23018__INTERRUPT_ON_CHANGE`) if no keys are pressed, this arms the
+//   interrupt
+static uint8_t _idle_strobe[2] = { DRIVE_PORT, DRIVE_ALL_LOW };
+static uint8_t _idle_data;
+static struct twi_transaction _idle_check = {
+	.address      = MCP23018_TWI_ADDRESS,
+	.write_length = 2,
+	.write_data   = _idle_strobe,
+	.read_length  = 1,
+	.read_data    = &_idle_data,
+};
+
+#if MCP23018__INTERRUPT_ON_CHANGE
+	// the interrupt flag check, as a single background transaction
+	//     S OP W INTF SR OP R Dout P
+	// - 4 bytes on the bus
+	// - this doesn't clear the interrupt state (reading GPIO does)
+	// - `_polled` is whether the last `mcp23018_update_matrix_start()`
+	//   queued this instead of a full scan
+	static uint8_t _intf_register = INPUT_INTF;
+	static uint8_t _intf_data;
+	static struct twi_transaction _intf_check = {
+		.address      = MCP23018_TWI_ADDRESS,
+		.write_length = 1,
+		.write_data   = &_intf_register,
+		.read_length  = 1,
+		.read_data    = &_intf_data,
+	};
+	static bool _polled;
+#endif
+
+// ----------------------------------------------------------------------------
+
+/* forget about the i/o expander (after a transfer failed), and re-initialize
+ * on the next scan
+ */
+static void _disconnected(uint8_t status) {
+	_count_error(status);
+	_initialized = false;
+	_backoff = 1;
+	_countdown = 1;
+}
+
+/* queue a full scan
+ */
+static void _queue_scan(void) {
+	for (uint8_t i=0; i<=STROBES; i++) {
+		// set active row (or column) low  : 0
+		// set the others hi-Z             : 1
+		// - after the last one, set all of them hi-Z
+		_strobe[i][0] = DRIVE_PORT;
+		#if MCP23018__DRIVE_ROWS
+			_strobe[i][1] = 0xFF & ~(1<<(5-i));
+		#elif MCP23018__DRIVE_COLUMNS
+			_strobe[i][1] = 0xFF & ~(1<<i);
+		#endif
+
+		_scan[i].address      = MCP23018_TWI_ADDRESS;
+		_scan[i].write_length = 2;
+		_scan[i].write_data   = _strobe[i];
+		_scan[i].read_length  = (i < STROBES) ? 1 : 0;
+		_scan[i].read_data    = &_data[i];
+		twi_queue(&_scan[i]);
 	}
+}
 
+// ----------------------------------------------------------------------------
 
-	// --------------------------------------------------------------------
-	// update our part of the matrix
+/* start reading our part of the matrix in the background
+ *
+ * returns:
+ * - success: 0
+ * - failure: 1 (the i/o expander isn't initialized)
+ *
+ * notes:
+ * - `mcp23018_update_matrix_finish()` must be called (exactly once) after
+ *   this, whether or not it succeeds
+ * - with `MCP23018__INTERRUPT_ON_CHANGE`, if no keys were pressed on our half
+ *   last time, this only checks whether anything has changed since; the full
+ *   scan is done (by `mcp23018_update_matrix_finish()`) only if it has
+ */
+uint8_t mcp23018_update_matrix_start(void) {
+	// if the i/o expander isn't there (see `mcp23018_check_connection()`)
+	if (!_initialized)
+		return 1;
 
-	#if MCP23018__DRIVE_ROWS
-		for (uint8_t row=0; row<=5; row++) {
-			// set active row low  : 0
-			// set other rows hi-Z : 1
-			twi_start();
-			twi_send(TWI_ADDR_WRITE);
-			twi_send(GPIOB);
-			twi_send( 0xFF & ~(1<<(5-row)) );
-			twi_stop();
-
-			// read column data
-			twi_start();
-			twi_send(TWI_ADDR_WRITE);
-			twi_send(GPIOA);
-			twi_start();
-			twi_send(TWI_ADDR_READ);
-			twi_read(&data);
-			twi_stop();
-
-			// update matrix
-			for (uint8_t col=0; col<=6; col++) {
-				matrix[row][col] = !( data & (1<<col) );
-			}
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		if (_armed) {
+			_polled = true;
+			twi_queue(&_intf_check);
+			return 0;  // success
 		}
+	#endif
 
-		// set all rows hi-Z : 1
-		twi_start();
-		twi_send(TWI_ADDR_WRITE);
-		twi_send(GPIOB);
-		twi_send(0xFF);
-		twi_stop();
+	_queue_scan();
 
-	#elif MCP23018__DRIVE_COLUMNS
-		for (uint8_t col=0; col<=6; col++) {
-			// set active column low  : 0
-			// set other columns hi-Z : 1
-			twi_start();
-			twi_send(TWI_ADDR_WRITE);
-			twi_send(GPIOA);
-			twi_send( 0xFF & ~(1<<col) );
-			twi_stop();
-
-			// read row data
-			twi_start();
-			twi_send(TWI_ADDR_WRITE);
-			twi_send(GPIOB);
-			twi_start();
-			twi_send(TWI_ADDR_READ);
-			twi_read(&data);
-			twi_stop();
-
-			// update matrix
-			for (uint8_t row=0; row<=5; row++) {
-				matrix[row][col] = !( data & (1<<(5-row)) );
+	return 0;  // success
+}
+
+/* wait for the scan started by `mcp23018_update_matrix_start()` to finish,
+ * and update our part of the matrix
+ *
+ * returns:
+ * - success: 0
+ * - failure: twi status code
+ */
+uint8_t mcp23018_update_matrix_finish(uint16_t matrix[KB_ROWS]) {
+	uint8_t ret = 0;
+
+	// clear our part of the matrix (columns 0..6)
+	for (uint8_t row=0; row<=5; row++)
+		matrix[row] &= ~0x7F;
+
+	// if the scan wasn't started (or there's nothing to wait for)
+	if (!_initialized)
+		return 1;
+
+	// wait for the scan
+	// - if the bus gets stuck, this gives up (after a bounded time),
+	//   recovers the bus, and marks the unfinished transactions as timed
+	//   out; so the right half keeps getting scanned either way
+	twi_wait();
+
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		if (_polled) {
+			_polled = false;
+
+			if (_intf_check.status) {
+				_disconnected(_intf_check.status);
+				return _intf_check.status;
 			}
+
+			// if nothing changed, no keys are pressed (still)
+			if (! (_intf_data & INPUT_MASK))
+				return 0;  // success
+
+			// else scan now
+			_armed = false;
+			_queue_scan();
+			twi_wait();
 		}
+	#endif
 
-		// set all columns hi-Z : 1
-		twi_start();
-		twi_send(TWI_ADDR_WRITE);
-		twi_send(GPIOA);
-		twi_send(0xFF);
-		twi_stop();
+	for (uint8_t i=0; i<=STROBES; i++)
+		if (_scan[i].status)
+			ret = _scan[i].status;
+
+	// if the i/o expander stopped responding partway through: forget what
+	// we read, and re-initialize on the next scan
+	if (ret) {
+		_disconnected(ret);
+		return ret;
+	}
+
+	// update our part of the matrix
+	#if MCP23018__DRIVE_ROWS
+		for (uint8_t row=0; row<=5; row++)
+			for (uint8_t col=0; col<=6; col++)
+				if ( !( _data[row] & (1<<col) ) )
+					matrix[row] |= (1<<col);
+	#elif MCP23018__DRIVE_COLUMNS
+		for (uint8_t col=0; col<=6; col++)
+			for (uint8_t row=0; row<=5; row++)
+				if ( !( _data[col] & (1<<(5-row)) ) )
+					matrix[row] |= (1<<col);
+	#endif
 
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		// if no keys are pressed on our half, drive everything low and
+		// arm the interrupt, so we don't have to scan again until
+		// something changes
+		bool down = false;
+		for (uint8_t row=0; row<=5; row++)
+			if (matrix[row] & 0x7F)
+				down = true;
+
+		if (! down) {
+			twi_queue(&_idle_check);
+			twi_wait();
+			if (_idle_check.status)
+				_disconnected(_idle_check.status);
+			else if (! ((~_idle_data) & INPUT_MASK))
+				_armed = true;
+		}
 	#endif
 
-	// /update our part of the matrix
-	// --------------------------------------------------------------------
+	return 0;  // success
+}
+
+/* start checking (in the background) whether any key on our half is pressed
+ *
+ * returns:
+ * - success: 0
+ * - failure: 1 (the i/o expander isn't initialized)
+ *
+ * notes:
+ * - `mcp23018_any_key_down_finish()` must be called (exactly once) after
+ *   this, whether or not it succeeds
+ * - with `MCP23018__INTERRUPT_ON_CHANGE`, if the interrupt is armed, this only
+ *   reads the interrupt flags
+ */
+uint8_t mcp23018_any_key_down_start(void) {
+	// if the i/o expander isn't there (see `mcp23018_check_connection()`)
+	if (!_initialized)
+		return 1;
+
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		if (_armed) {
+			twi_queue(&_intf_check);
+			return 0;  // success
+		}
+	#endif
 
-	return ret;  // success
+	twi_queue(&_idle_check);
+	return 0;  // success
 }
 
+/* wait for the check started by `mcp23018_any_key_down_start()` to finish
+ *
+ * returns:
+ * - whether any key on our half is pressed (false if the i/o expander isn't
+ *   responding)
+ */
+bool mcp23018_any_key_down_finish(void) {
+	if (!_initialized)
+		return false;
+
+	twi_wait();
+
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		if (_armed) {
+			if (_intf_check.status) {
+				_disconnected(_intf_check.status);
+				return false;
+			}
+			if (! (_intf_data & INPUT_MASK))
+				return false;
+
+			// something changed: the next scan should be a full one
+			_armed = false;
+			return true;
+		}
+	#endif
+
+	if (_idle_check.status) {
+		_disconnected(_idle_check.status);
+		return false;
+	}
+
+	if ((~_idle_data) & INPUT_MASK)
+		return true;
+
+	#if MCP23018__INTERRUPT_ON_CHANGE
+		// nothing pressed, and the interrupt state is cleared (by reading
+		// the port)
+		_armed = true;
+	#endif
+	return false;
+}
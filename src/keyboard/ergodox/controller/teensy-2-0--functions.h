@@ -17,7 +17,8 @@
 	// --------------------------------------------------------------------
 
 	uint8_t teensy_init(void);
-	uint8_t teensy_update_matrix( bool matrix[KB_ROWS][KB_COLUMNS] );
+	uint8_t teensy_update_matrix( uint16_t matrix[KB_ROWS] );
+	bool    teensy_any_key_down(void);
 
 #endif
 
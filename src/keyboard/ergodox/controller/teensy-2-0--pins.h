@@ -0,0 +1,84 @@
+/* ----------------------------------------------------------------------------
+ * ergoDOX : controller : Teensy 2.0 specific code : pin masks
+ *
+ * - Macros for working out, from the pin macros (`ROW_n`, `COLUMN_n`,
+ *   `UNUSED_n`, each `<port letter>, <pin number>`), which pins are on which
+ *   port.  They only use the pin macros when they're expanded, so the pins
+ *   may be defined after this is included.
+ * - Separate from "teensy-2-0.c" so they can be checked on the host (see
+ *   "../../../host/check/teensy-2-0-pins.c"), with every placement of the
+ *   pins.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef KEYBOARD__ERGODOX__CONTROLLER__TEENSY_2_0__PINS_h
+	#define KEYBOARD__ERGODOX__CONTROLLER__TEENSY_2_0__PINS_h
+
+	// --------------------------------------------------------------------
+
+	#define  _PORT_B  1
+	#define  _PORT_C  2
+	#define  _PORT_D  3
+	#define  _PORT_E  4
+	#define  _PORT_F  5
+
+	#define  _teensypin_port(pin_letter, pin_number)  _PORT_##pin_letter
+	#define  teensypin_port(pin)  _teensypin_port(pin)
+
+	#define  _teensypin_number(pin_letter, pin_number)  pin_number
+	#define  teensypin_number(pin)  _teensypin_number(pin)
+
+	// --------------------------------------------------------------------
+
+	// --- per port masks
+	// - `teensypin_mask(port, pin)` is `(1<<pin_number)` if `pin` is on
+	//   `port`, and 0 otherwise; so, e.g., `ROW_MASK(F)` is the bits of
+	//   all the rows that are on port F.  these are all constant, so
+	//   they're computed at compile time.
+	#define  _teensypin_mask(port, pin_letter, pin_number)		\
+		( (_PORT_##port == _PORT_##pin_letter) ? (1<<(pin_number)) : 0 )
+	#define  teensypin_mask(port, pin)	\
+		_teensypin_mask(port, pin)
+
+	#define  UNUSED_MASK(port)			\
+		( teensypin_mask(port, UNUSED_0)	\
+		| teensypin_mask(port, UNUSED_1)	\
+		| teensypin_mask(port, UNUSED_2)	\
+		| teensypin_mask(port, UNUSED_3)	\
+		| teensypin_mask(port, UNUSED_4) )
+
+	#define  ROW_MASK(port)				\
+		( teensypin_mask(port, ROW_0)		\
+		| teensypin_mask(port, ROW_1)		\
+		| teensypin_mask(port, ROW_2)		\
+		| teensypin_mask(port, ROW_3)		\
+		| teensypin_mask(port, ROW_4)		\
+		| teensypin_mask(port, ROW_5) )
+
+	#define  COLUMN_MASK(port)			\
+		( teensypin_mask(port, COLUMN_7)	\
+		| teensypin_mask(port, COLUMN_8)	\
+		| teensypin_mask(port, COLUMN_9)	\
+		| teensypin_mask(port, COLUMN_A)	\
+		| teensypin_mask(port, COLUMN_B)	\
+		| teensypin_mask(port, COLUMN_C)	\
+		| teensypin_mask(port, COLUMN_D) )
+
+	// --- rows, from one port
+	// - `rows_from_port(pins)`: if all the rows are on one port, and
+	//   `pins` is what was read from it, bit `n` of the result is row `n`
+	//   (with shifts that are worked out at compile time, from the pin
+	//   macros)
+	#define  _row_bit(pins, row)	\
+		( (((pins) >> teensypin_number(ROW_##row)) & 1) << (row) )
+	#define  rows_from_port(pins)				\
+		( _row_bit(pins, 0) | _row_bit(pins, 1)		\
+		| _row_bit(pins, 2) | _row_bit(pins, 3)		\
+		| _row_bit(pins, 4) | _row_bit(pins, 5) )
+
+#endif
+
@@ -7,9 +7,6 @@
  * ------------------------------------------------------------------------- */
 
 
-// for "lib/twi.h"
-#define TWI_FREQ 400000
-
 #include <stdbool.h>
 #include <stdint.h>
 #include <avr/io.h>
@@ -19,6 +16,7 @@
 #include "../matrix.h"
 #include "./teensy-2-0--functions.h"
 #include "./teensy-2-0--led.h"
+#include "./teensy-2-0--pins.h"
 
 // ----------------------------------------------------------------------------
 
@@ -81,10 +79,7 @@
 #define  CLEAR  &=~
 
 #define  _teensypin_write(register, operation, pin_letter, pin_number)	\
-	do {								\
-		((register##pin_letter) operation (1<<(pin_number)));	\
-		_delay_us(1);  /* allow pins time to stabilize */	\
-	} while(0)
+	((register##pin_letter) operation (1<<(pin_number)))
 #define  teensypin_write(register, operation, pin)	\
 	_teensypin_write(register, operation, pin)
 
@@ -93,67 +88,115 @@
 #define  teensypin_read(pin)	\
 	_teensypin_read(pin)
 
-#define  teensypin_write_all_unused(register, operation)		\
-	do {								\
-		teensypin_write(register, operation, UNUSED_0);		\
-		teensypin_write(register, operation, UNUSED_1);		\
-		teensypin_write(register, operation, UNUSED_2);		\
-		teensypin_write(register, operation, UNUSED_3);		\
-		teensypin_write(register, operation, UNUSED_4); }	\
-	while(0)
-
-#define  teensypin_write_all_row(register, operation)		\
+#define  _teensypin_pin_register(pin_letter, pin_number)  PIN##pin_letter
+#define  teensypin_pin_register(pin)  _teensypin_pin_register(pin)
+
+// allow pins time to stabilize (after a write)
+#define  teensypin_settle()  _delay_us(1)
+
+// --- rows, all at once
+// - if all the rows are on the same port, we can read them all at once, and
+//   then shuffle the bits (with `rows_from_port()`, see "teensy-2-0--pins.h")
+//   so that bit `n` is row `n`
+#if    teensypin_port(ROW_0) == teensypin_port(ROW_1)	\
+    && teensypin_port(ROW_0) == teensypin_port(ROW_2)	\
+    && teensypin_port(ROW_0) == teensypin_port(ROW_3)	\
+    && teensypin_port(ROW_0) == teensypin_port(ROW_4)	\
+    && teensypin_port(ROW_0) == teensypin_port(ROW_5)
+	#define  ROWS_ON_ONE_PORT  1
+#else
+	#define  ROWS_ON_ONE_PORT  0
+#endif
+
+// --- writing (and reading) whole sets of pins
+// - the sets are given as per port masks (`UNUSED_MASK`, `ROW_MASK`, or
+//   `COLUMN_MASK`, see "teensy-2-0--pins.h")
+// - one register write per port that has pins in the set (ports without any
+//   are skipped at compile time), and then one settling delay for all of them
+// - `_teensyport_write()` doesn't wait for the pins to settle
+#define  _teensyport_write(register, operation, mask)		\
 	do {							\
-		teensypin_write(register, operation, ROW_0);	\
-		teensypin_write(register, operation, ROW_1);	\
-		teensypin_write(register, operation, ROW_2);	\
-		teensypin_write(register, operation, ROW_3);	\
-		teensypin_write(register, operation, ROW_4);	\
-		teensypin_write(register, operation, ROW_5); }	\
-	while(0)
-
-#define  teensypin_write_all_column(register, operation)		\
-	do {								\
-		teensypin_write(register, operation, COLUMN_7);		\
-		teensypin_write(register, operation, COLUMN_8);		\
-		teensypin_write(register, operation, COLUMN_9);		\
-		teensypin_write(register, operation, COLUMN_A);		\
-		teensypin_write(register, operation, COLUMN_B);		\
-		teensypin_write(register, operation, COLUMN_C);		\
-		teensypin_write(register, operation, COLUMN_D); }	\
-	while(0)
+		if (mask(B)) ((register##B) operation mask(B));	\
+		if (mask(C)) ((register##C) operation mask(C));	\
+		if (mask(D)) ((register##D) operation mask(D));	\
+		if (mask(E)) ((register##E) operation mask(E));	\
+		if (mask(F)) ((register##F) operation mask(F));	\
+	} while(0)
+#define  teensyport_write(register, operation, mask)	\
+	do {						\
+		_teensyport_write(register, operation, mask);	\
+		teensypin_settle();			\
+	} while(0)
+
+// - evaluates to non-zero if any pin in the set is low
+#define  teensyport_any_low(mask)				\
+	( (mask(B) ? (~PINB & mask(B)) : 0)			\
+	| (mask(C) ? (~PINC & mask(C)) : 0)			\
+	| (mask(D) ? (~PIND & mask(D)) : 0)			\
+	| (mask(E) ? (~PINE & mask(E)) : 0)			\
+	| (mask(F) ? (~PINF & mask(F)) : 0) )
+
+#define  teensypin_write_all_unused(register, operation)	\
+	teensyport_write(register, operation, UNUSED_MASK)
+#define  teensypin_write_all_row(register, operation)	\
+	teensyport_write(register, operation, ROW_MASK)
+#define  teensypin_write_all_column(register, operation)	\
+	teensyport_write(register, operation, COLUMN_MASK)
 
 
 /*
  * update macros
+ * - these only set bits (for keys that are pressed); our part of the matrix
+ *   must be cleared first
+ * - the only delay is after driving the column (or row) low: releasing it
+ *   doesn't need one, since the next column (or row) we drive gets its own
  */
+#if ROWS_ON_ONE_PORT
 #define  update_rows_for_column(matrix, column)				\
 	do {								\
 		/* set column low (set as output) */			\
 		teensypin_write(DDR, SET, COLUMN_##column);		\
+		teensypin_settle();					\
+		/* read rows 0..5 (all at once) and update matrix */	\
+		uint8_t rows = rows_from_port(				\
+				~teensypin_pin_register(ROW_0) );	\
+		for (uint8_t row=0; rows; row++, rows>>=1)		\
+			if (rows & 1)					\
+				matrix[row] |= (1<<0x##column);		\
+		/* set column hi-Z (set as input) */			\
+		teensypin_write(DDR, CLEAR, COLUMN_##column);		\
+	} while(0)
+#else
+#define  update_rows_for_column(matrix, column)				\
+	do {								\
+		/* set column low (set as output) */			\
+		teensypin_write(DDR, SET, COLUMN_##column);		\
+		teensypin_settle();					\
 		/* read rows 0..5 and update matrix */			\
-		matrix[0x0][0x##column] = ! teensypin_read(ROW_0);	\
-		matrix[0x1][0x##column] = ! teensypin_read(ROW_1);	\
-		matrix[0x2][0x##column] = ! teensypin_read(ROW_2);	\
-		matrix[0x3][0x##column] = ! teensypin_read(ROW_3);	\
-		matrix[0x4][0x##column] = ! teensypin_read(ROW_4);	\
-		matrix[0x5][0x##column] = ! teensypin_read(ROW_5);	\
+		if (! teensypin_read(ROW_0)) matrix[0x0] |= (1<<0x##column); \
+		if (! teensypin_read(ROW_1)) matrix[0x1] |= (1<<0x##column); \
+		if (! teensypin_read(ROW_2)) matrix[0x2] |= (1<<0x##column); \
+		if (! teensypin_read(ROW_3)) matrix[0x3] |= (1<<0x##column); \
+		if (! teensypin_read(ROW_4)) matrix[0x4] |= (1<<0x##column); \
+		if (! teensypin_read(ROW_5)) matrix[0x5] |= (1<<0x##column); \
 		/* set column hi-Z (set as input) */			\
 		teensypin_write(DDR, CLEAR, COLUMN_##column);		\
 	} while(0)
+#endif
 
 #define  update_columns_for_row(matrix, row)				\
 	do {								\
 		/* set row low (set as output) */			\
 		teensypin_write(DDR, SET, ROW_##row);			\
+		teensypin_settle();					\
 		/* read columns 7..D and update matrix */		\
-		matrix[0x##row][0x7] = ! teensypin_read(COLUMN_7);	\
-		matrix[0x##row][0x8] = ! teensypin_read(COLUMN_8);	\
-		matrix[0x##row][0x9] = ! teensypin_read(COLUMN_9);	\
-		matrix[0x##row][0xA] = ! teensypin_read(COLUMN_A);	\
-		matrix[0x##row][0xB] = ! teensypin_read(COLUMN_B);	\
-		matrix[0x##row][0xC] = ! teensypin_read(COLUMN_C);	\
-		matrix[0x##row][0xD] = ! teensypin_read(COLUMN_D);	\
+		if (! teensypin_read(COLUMN_7)) matrix[0x##row] |= (1<<0x7); \
+		if (! teensypin_read(COLUMN_8)) matrix[0x##row] |= (1<<0x8); \
+		if (! teensypin_read(COLUMN_9)) matrix[0x##row] |= (1<<0x9); \
+		if (! teensypin_read(COLUMN_A)) matrix[0x##row] |= (1<<0xA); \
+		if (! teensypin_read(COLUMN_B)) matrix[0x##row] |= (1<<0xB); \
+		if (! teensypin_read(COLUMN_C)) matrix[0x##row] |= (1<<0xC); \
+		if (! teensypin_read(COLUMN_D)) matrix[0x##row] |= (1<<0xD); \
 		/* set row hi-Z (set as input) */			\
 		teensypin_write(DDR, CLEAR, ROW_##row);			\
 	} while(0)
@@ -212,7 +255,11 @@ uint8_t teensy_init(void) {
 	#error "Expecting different keyboard dimensions"
 #endif
 
-uint8_t teensy_update_matrix(bool matrix[KB_ROWS][KB_COLUMNS]) {
+uint8_t teensy_update_matrix(uint16_t matrix[KB_ROWS]) {
+	// clear our part of the matrix (columns 7..D)
+	for (uint8_t row=0; row<=5; row++)
+		matrix[row] &= ~(0x7F<<7);
+
 	#if TEENSY__DRIVE_ROWS
 		update_columns_for_row(matrix, 0);
 		update_columns_for_row(matrix, 1);
@@ -232,3 +279,27 @@ uint8_t teensy_update_matrix(bool matrix[KB_ROWS][KB_COLUMNS]) {
 
 	return 0;  // success
 }
+
+/* returns
+ * - whether any key on our half is pressed
+ *
+ * notes
+ * - this drives all the columns (or rows) at once, and reads all the rows (or
+ *   columns), so it's much faster than a full scan, but can't tell which keys
+ *   are pressed
+ */
+bool teensy_any_key_down(void) {
+	bool down;
+
+	#if TEENSY__DRIVE_ROWS
+		teensypin_write_all_row(DDR, SET);      // set low (as output)
+		down = teensyport_any_low(COLUMN_MASK);
+		_teensyport_write(DDR, CLEAR, ROW_MASK);  // set hi-Z (as input)
+	#elif TEENSY__DRIVE_COLUMNS
+		teensypin_write_all_column(DDR, SET);   // set low (as output)
+		down = teensyport_any_low(ROW_MASK);
+		_teensyport_write(DDR, CLEAR, COLUMN_MASK);  // set hi-Z (as input)
+	#endif
+
+	return down;
+}
@@ -46,17 +46,17 @@
 #include "../matrix.h"
 #include "../layout.h"
 // FUNCTIONS ------------------------------------------------------------------
-void kbfun_layer_pop_all(void) {
-  kbfun_layer_pop_1();
-  kbfun_layer_pop_2();
-  kbfun_layer_pop_3();
-  kbfun_layer_pop_4();
-  kbfun_layer_pop_5();
-  kbfun_layer_pop_6();
-  kbfun_layer_pop_7();
-  kbfun_layer_pop_8();
-  kbfun_layer_pop_9();
-  kbfun_layer_pop_10();
+void kbfun_layer_pop_all(struct key_event * event) {
+  kbfun_layer_pop_1(event);
+  kbfun_layer_pop_2(event);
+  kbfun_layer_pop_3(event);
+  kbfun_layer_pop_4(event);
+  kbfun_layer_pop_5(event);
+  kbfun_layer_pop_6(event);
+  kbfun_layer_pop_7(event);
+  kbfun_layer_pop_8(event);
+  kbfun_layer_pop_9(event);
+  kbfun_layer_pop_10(event);
 }
 
 // DEFINITIONS ----------------------------------------------------------------
@@ -150,7 +150,7 @@ KB_MATRIX_LAYER(
 // ----------------------------------------------------------------------------
 
 // PRESS ----------------------------------------------------------------------
-const void_funptr_t PROGMEM _kb_layout_press[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
+const kbfun_funptr_t PROGMEM _kb_layout_press[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
 // LAYER 0
 KB_MATRIX_LAYER(
 	// unused
@@ -224,7 +224,7 @@ KB_MATRIX_LAYER(
 // ----------------------------------------------------------------------------
 
 // RELEASE --------------------------------------------------------------------
-const void_funptr_t PROGMEM _kb_layout_release[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
+const kbfun_funptr_t PROGMEM _kb_layout_release[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
 // LAYER 0
 KB_MATRIX_LAYER(
 	// unused
@@ -6,13 +6,15 @@
 * Project located at <https://github.com/benblazak/ergodox-firmware>
 * -------------------------------------------------------------------------- */
 
-// TODO: there is a bug where if you hit an inverted key and a normal key, at
-// the same time, when the 6 key buffer and modifier states are sent the
-// inverted key's shift state can be used for the non-inverted key.
+// NOTE: if you hit an inverted key and a normal key at the same time, and all
+// the changes from one scan are sent in a single report, the inverted key's
+// shift state can be used for the non-inverted key.
 // Example: hit 1 and q at the same time in workman-p, you may end up with "!Q"
-// instead of "!q".  Not sure how to fix this at present, but it may require
-// sending two frames of updates to properly denote an order (shifted in one
-// update, unshifted added in another, as though shift was released).
+// instead of "!q".  Building with `REPORT_PER_EVENT := 1` (the default, see
+// "src/makefile-options") fixes this, by sending a report for each key as it's
+// processed: "q" goes out unshifted in one report, and "!" (with shift) in the
+// next, so the host types "q!" (see
+// "src/host/check/workman-p-kinesis-mod/shifted-and-unshifted.trace").
 
 #include <stdint.h>
 #include <stddef.h>
@@ -26,26 +28,26 @@
 
 #define USING_WORKMAN_P // undef to use standard workman
 
-// convenience macros
-#define  LAYER         main_arg_layer
-#define  LAYER_OFFSET  main_arg_layer_offset
-#define  ROW           main_arg_row
-#define  COL           main_arg_col
-#define  IS_PRESSED    main_arg_is_pressed
-#define  WAS_PRESSED   main_arg_was_pressed
+// convenience macros (for functions with an `event` argument)
+#define  LAYER         (event->layer)
+#define  LAYER_OFFSET  (event->layer_offset)
+#define  ROW           (event->row)
+#define  COL           (event->col)
+#define  IS_PRESSED    (event->is_pressed)
+#define  WAS_PRESSED   (event->was_pressed)
 
 // FUNCTIONS ------------------------------------------------------------------
-void kbfun_layer_pop_all(void) {
-  kbfun_layer_pop_1();
-  kbfun_layer_pop_2();
-  kbfun_layer_pop_3();
-  kbfun_layer_pop_4();
-  kbfun_layer_pop_5();
-  kbfun_layer_pop_6();
-  kbfun_layer_pop_7();
-  kbfun_layer_pop_8();
-  kbfun_layer_pop_9();
-  kbfun_layer_pop_10();
+void kbfun_layer_pop_all(struct key_event * event) {
+  kbfun_layer_pop_1(event);
+  kbfun_layer_pop_2(event);
+  kbfun_layer_pop_3(event);
+  kbfun_layer_pop_4(event);
+  kbfun_layer_pop_5(event);
+  kbfun_layer_pop_6(event);
+  kbfun_layer_pop_7(event);
+  kbfun_layer_pop_8(event);
+  kbfun_layer_pop_9(event);
+  kbfun_layer_pop_10(event);
 }
 
 
@@ -75,13 +77,13 @@ void restore_shift_state() {
  *   key release if shift is not pressed.  Generate a normal keypress or
  *   key release if shift is pressed.
  */
-void kbfun_invert_shift_press_release(void) {
+void kbfun_invert_shift_press_release(struct key_event * event) {
   if (IS_PRESSED) {
     ++inverted_keys_pressed;
     invert_shift_state();
   }
 
-  kbfun_press_release();
+  kbfun_press_release(event);
 
   if (!IS_PRESSED) {
     // if this is the last key we're releasing
@@ -104,7 +106,7 @@ void kbfun_invert_shift_press_release(void) {
  *   If inverted keys are pressed, fix the shift state back to that of the
  *   physical keys before pressing the key.
  */
-void kbfun_fix_shifted_press_release(void) {
+void kbfun_fix_shifted_press_release(struct key_event * event) {
   uint8_t keycode = kb_layout_get(LAYER, ROW, COL);
   switch (keycode) {
     // shift state toggles
@@ -117,7 +119,7 @@ void kbfun_fix_shifted_press_release(void) {
     // Keys which don't break it
     case KEY_CapsLock:
     case KEYPAD_NumLock_Clear:
-      kbfun_press_release();
+      kbfun_press_release(event);
       return;
     default:
       // If we're not just changing the modifier, we need our true shift state.
@@ -125,14 +127,14 @@ void kbfun_fix_shifted_press_release(void) {
         inverted_keys_pressed = 0;
         restore_shift_state();
       }
-      kbfun_press_release();
+      kbfun_press_release(event);
       return;
   }
   // We only get here if we pressed left or right shift
   if (inverted_keys_pressed) {
     invert_shift_state();
   } else {
-    kbfun_press_release();
+    kbfun_press_release(event);
   }
 }
 
@@ -458,7 +460,7 @@ KB_MATRIX_LAYER(
 // ----------------------------------------------------------------------------
 
 // PRESS ----------------------------------------------------------------------
-const void_funptr_t PROGMEM _kb_layout_press[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
+const kbfun_funptr_t PROGMEM _kb_layout_press[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
 // LAYER 0
 KB_MATRIX_LAYER(
   // unused
@@ -723,7 +725,7 @@ KB_MATRIX_LAYER(
 // ----------------------------------------------------------------------------
 
 // RELEASE --------------------------------------------------------------------
-const void_funptr_t PROGMEM _kb_layout_release[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
+const kbfun_funptr_t PROGMEM _kb_layout_release[KB_LAYERS][KB_ROWS][KB_COLUMNS] = {
 // LAYER 0
 KB_MATRIX_LAYER(
   // unused
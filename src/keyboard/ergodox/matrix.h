@@ -15,6 +15,11 @@
 	#define KB_ROWS      6  // must match real life
 	#define KB_COLUMNS  14  // must match real life
 
+	/* the matrix itself (as filled in by `kb_update_matrix()`) is an
+	 * array of `KB_ROWS` `uint16_t`s, one per row, with bit `n` of each
+	 * row set if the key in column `n` is pressed
+	 */
+
 	// --------------------------------------------------------------------
 
 	/* mapping from spatial position to matrix position
@@ -37,4 +37,71 @@
 	#define  MCP23018__DRIVE_ROWS     0
 	#define  MCP23018__DRIVE_COLUMNS  1
 
+	// --------------------------------------------------------------------
+
+	/*
+	 * MCP23018__PROBE_INTERVAL and MCP23018__BACKOFF_MAX
+	 * - The MCP23018 (left hand) is initialized once, not on every scan.
+	 *   While it's connected, we check that it's still configured every
+	 *   `MCP23018__PROBE_INTERVAL` scans (re-initializing it if it was
+	 *   unplugged and plugged back in).  While it isn't connected, we try
+	 *   to initialize it again after 1, 2, 4, ... scans, up to
+	 *   `MCP23018__BACKOFF_MAX` scans between attempts.
+	 *
+	 * Notes
+	 * - Both are counted in scans, so the times they correspond to depend
+	 *   on `SCAN_RATE` (in the makefile).  At 1000 scans per second, the
+	 *   defaults are about 1/4 of a second and 1 second.
+	 * - A transfer that isn't acknowledged during a scan marks the
+	 *   MCP23018 as disconnected right away; the probe is only there to
+	 *   catch it having been reset between scans.
+	 */
+	#define  MCP23018__PROBE_INTERVAL  256
+	#define  MCP23018__BACKOFF_MAX     1024
+
+	// --------------------------------------------------------------------
+
+	/*
+	 * MCP23018__INTERRUPT_ON_CHANGE
+	 * - If 1, when no keys on the left hand are pressed, the MCP23018 is
+	 *   left with all its columns (or rows) driven low, and interrupt-on-
+	 *   change enabled for the rows (or columns).  Each scan then only
+	 *   reads the interrupt flags (1 TWI transaction, 4 bytes), and the
+	 *   left hand is only scanned in full if something changed.
+	 *
+	 * Notes
+	 * - A change only triggers a full scan; the key states still come
+	 *   from that scan, and the captured port value (INTCAP) is never
+	 *   read.  So a press and release that both happen between two scans
+	 *   is missed, the same as without this option.
+	 * - The INTA and INTB pins aren't connected on the ergoDOX, so the
+	 *   interrupt flags are polled over TWI, instead of the MCP23018
+	 *   telling us when they change.
+	 * - This doesn't affect the right hand, which is scanned the same way
+	 *   either way.
+	 */
+	#define  MCP23018__INTERRUPT_ON_CHANGE  0
+
+	// --------------------------------------------------------------------
+
+	/*
+	 * KB__IDLE_CHECK and KB__IDLE_HYSTERESIS
+	 * - If `KB__IDLE_CHECK` is 1, when no keys have been pressed for a
+	 *   while, each scan first drives all the columns (or rows) at once
+	 *   and checks whether any row (or column) reads low.  The full scan
+	 *   is only done if one does.  On the left hand, this is 1 TWI
+	 *   transaction (5 bytes) instead of 7 (plus one to set everything
+	 *   back to hi-Z).
+	 * - `KB__IDLE_HYSTERESIS` is how many scans to keep doing full scans
+	 *   after the last time a key was seen pressed, so that while typing,
+	 *   every scan is a full scan (and the idle check doesn't add latency
+	 *   to any key press but the first).
+	 *
+	 * Notes
+	 * - `KB__IDLE_HYSTERESIS` is counted in scans (see `SCAN_RATE` in the
+	 *   makefile).  At 1000 scans per second, the default is 1/2 a second.
+	 */
+	#define  KB__IDLE_CHECK       1
+	#define  KB__IDLE_HYSTERESIS  500
+
 #endif
@@ -53,6 +53,25 @@
 // operating systems.
 #define SUPPORT_ENDPOINT_HALT
 
+// How often (in ms) the host should poll the keyboard and extra endpoints
+// for new reports.  Full speed interrupt endpoints may ask for anything from
+// 1 to 255; every extra ms here is up to an extra ms of latency per keystroke.
+#ifdef MAKEFILE_USB_POLL_INTERVAL
+#define USB_POLL_INTERVAL	MAKEFILE_USB_POLL_INTERVAL
+#else
+#define USB_POLL_INTERVAL	1
+#endif
+
+// The default idle rate (in units of 4 ms), used until the host sends a
+// SET_IDLE.  The SOF interrupt counts these off independently of the poll
+// interval, but an idle resend can't go out any more often than the host
+// polls for it.
+#define KEYBOARD_IDLE_DEFAULT	125
+
+#if USB_POLL_INTERVAL < 1 || USB_POLL_INTERVAL > 255
+#error "USB_POLL_INTERVAL must be between 1 and 255 (ms)"
+#endif
+
 /* report id */
 #define REPORT_ID_SYSTEM    2
 #define REPORT_ID_CONSUMER  3
@@ -74,10 +93,41 @@
 #define EXTRA_SIZE		8
 #define EXTRA_BUFFER		EP_DOUBLE_BUFFER
 
+// the debug console (compatible with PJRC's "hid_listen"), if enabled
+#ifndef MAKEFILE_USB_DEBUG
+#define MAKEFILE_USB_DEBUG	0
+#endif
+#define DEBUG_INTERFACE		2
+#define DEBUG_TX_ENDPOINT	3
+#define DEBUG_TX_SIZE		32
+#define DEBUG_TX_BUFFER		EP_DOUBLE_BUFFER
+
+
+// Reports are queued by usb_keyboard_send() and usb_extra_send(), and
+// written to the endpoints (in order) as soon as they have room, either
+// right away or from the start of frame interrupt.  Queue sizes must be
+// powers of 2.
+#define KEYBOARD_QUEUE_SIZE	8
+#define KEYBOARD_QUEUE_MASK	(KEYBOARD_QUEUE_SIZE-1)
+#define EXTRA_QUEUE_SIZE	4
+#define EXTRA_QUEUE_MASK	(EXTRA_QUEUE_SIZE-1)
+#define EXTRA_REPORT_SIZE	3
+
+// Debug output is buffered by usb_debug_putchar(), and written to the
+// endpoint (one zero padded packet at a time) from the start of frame
+// interrupt.  Must be a power of 2, and at most 128.
+#define DEBUG_BUFFER_SIZE	128
+#define DEBUG_BUFFER_MASK	(DEBUG_BUFFER_SIZE-1)
+
 
 static const uint8_t PROGMEM endpoint_config_table[] = {
 	1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(KEYBOARD_SIZE) | KEYBOARD_BUFFER,
 	1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(EXTRA_SIZE)    | EXTRA_BUFFER,    // 4
+#if MAKEFILE_USB_DEBUG
+	1, EP_TYPE_INTERRUPT_IN,  EP_SIZE(DEBUG_TX_SIZE) | DEBUG_TX_BUFFER,
+#else
+	0,
+#endif
 	0
 };
 
@@ -166,13 +216,35 @@ static const uint8_t PROGMEM extra_hid_report_desc[] = {
     0xc0,                          // END_COLLECTION
 };
 
+#if MAKEFILE_USB_DEBUG
+// debug console, PJRC's "usb_debug_only" example
+static const uint8_t PROGMEM debug_hid_report_desc[] = {
+	0x06, 0x31, 0xFF,			// Usage Page 0xFF31 (vendor defined)
+	0x09, 0x74,				// Usage 0x74
+	0xA1, 0x53,				// Collection 0x53
+	0x75, 0x08,				// report size = 8 bits
+	0x15, 0x00,				// logical minimum = 0
+	0x26, 0xFF, 0x00,			// logical maximum = 255
+	0x95, DEBUG_TX_SIZE,			// report count
+	0x09, 0x75,				// usage
+	0x81, 0x02,				// Input (array)
+	0xC0					// end collection
+};
+#endif
+
 #define KEYBOARD_HID_DESC_NUM                0
 #define KEYBOARD_HID_DESC_OFFSET             (9+(9+9+7)*KEYBOARD_HID_DESC_NUM+9)
 
 #   define EXTRA_HID_DESC_NUM           (KEYBOARD_HID_DESC_NUM + 1)
 #   define EXTRA_HID_DESC_OFFSET        (9+(9+9+7)*EXTRA_HID_DESC_NUM+9)
 
-#define NUM_INTERFACES                  (EXTRA_HID_DESC_NUM + 1)
+#if MAKEFILE_USB_DEBUG
+#   define DEBUG_HID_DESC_NUM           (EXTRA_HID_DESC_NUM + 1)
+#   define DEBUG_HID_DESC_OFFSET        (9+(9+9+7)*DEBUG_HID_DESC_NUM+9)
+#   define NUM_INTERFACES               (DEBUG_HID_DESC_NUM + 1)
+#else
+#   define NUM_INTERFACES               (EXTRA_HID_DESC_NUM + 1)
+#endif
 #define CONFIG1_DESC_SIZE               (9+(9+9+7)*NUM_INTERFACES)
 //#define KEYBOARD_HID_DESC_OFFSET (9+9)
 static const uint8_t PROGMEM config1_descriptor[CONFIG1_DESC_SIZE] = {
@@ -212,7 +284,7 @@ static const uint8_t PROGMEM config1_descriptor[CONFIG1_DESC_SIZE] = {
 	KEYBOARD_ENDPOINT | 0x80,			// bEndpointAddress
 	0x03,					// bmAttributes (0x03=intr)
 	KEYBOARD_SIZE, 0,				// wMaxPacketSize
-	10,					// bInterval
+	USB_POLL_INTERVAL,			// bInterval
 
 	// interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
 	9,					// bLength
@@ -239,7 +311,36 @@ static const uint8_t PROGMEM config1_descriptor[CONFIG1_DESC_SIZE] = {
 	EXTRA_ENDPOINT | 0x80,			// bEndpointAddress
 	0x03,					// bmAttributes (0x03=intr)
 	EXTRA_SIZE, 0,				// wMaxPacketSize
-	10,					// bInterval
+	USB_POLL_INTERVAL,			// bInterval
+#if MAKEFILE_USB_DEBUG
+
+	// interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
+	9,					// bLength
+	4,					// bDescriptorType
+	DEBUG_INTERFACE,			// bInterfaceNumber
+	0,					// bAlternateSetting
+	1,					// bNumEndpoints
+	0x03,					// bInterfaceClass (0x03 = HID)
+	0x00,					// bInterfaceSubClass
+	0x00,					// bInterfaceProtocol
+	0,					// iInterface
+	// HID descriptor, HID 1.11 spec, section 6.2.1
+	9,					// bLength
+	0x21,					// bDescriptorType
+	0x11, 0x01,				// bcdHID
+	0,					// bCountryCode
+	1,					// bNumDescriptors
+	0x22,					// bDescriptorType
+	sizeof(debug_hid_report_desc),		// wDescriptorLength
+	0,
+	// endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+	7,					// bLength
+	5,					// bDescriptorType
+	DEBUG_TX_ENDPOINT | 0x80,		// bEndpointAddress
+	0x03,					// bmAttributes (0x03=intr)
+	DEBUG_TX_SIZE, 0,			// wMaxPacketSize
+	1,					// bInterval
+#endif
 };
 
 // If you're desperate for a little extra code memory, these strings
@@ -284,6 +385,11 @@ static struct descriptor_list_struct {
 	    // Extra HID Descriptor
 	{0x2100, EXTRA_INTERFACE, config1_descriptor+EXTRA_HID_DESC_OFFSET, 9},
 	{0x2200, EXTRA_INTERFACE, extra_hid_report_desc, sizeof(extra_hid_report_desc)},
+#if MAKEFILE_USB_DEBUG
+	    // Debug HID Descriptor
+	{0x2100, DEBUG_INTERFACE, config1_descriptor+DEBUG_HID_DESC_OFFSET, 9},
+	{0x2200, DEBUG_INTERFACE, debug_hid_report_desc, sizeof(debug_hid_report_desc)},
+#endif
         // STRING descriptors
 	{0x0300, 0x0000, (const uint8_t *)&string0, 4},
 	{0x0301, 0x0409, (const uint8_t *)&string1, sizeof(STR_MANUFACTURER)},
@@ -309,6 +415,11 @@ uint8_t keyboard_modifier_keys=0;
 // which keys are currently pressed, up to 6 keys may be down at once
 uint8_t keyboard_keys[6]={0,0,0,0,0,0};
 
+// non-zero when keyboard_modifier_keys or keyboard_keys have been changed
+// since the last report was sent (set by whoever changes them, cleared by
+// usb_keyboard_send())
+uint8_t keyboard_report_changed=0;
+
 // protocol setting from the host.  We use exactly the same report
 // either way, so this variable only stores the setting since we
 // are required to be able to report which setting is in use.
@@ -316,7 +427,7 @@ static uint8_t keyboard_protocol=1;
 
 // the idle configuration, how often we send the report to the
 // host (ms * 4) even when it hasn't changed
-static uint8_t keyboard_idle_config=125;
+static uint8_t keyboard_idle_config=KEYBOARD_IDLE_DEFAULT;
 
 // count until idle timeout
 static uint8_t keyboard_idle_count=0;
@@ -328,6 +439,47 @@ volatile uint8_t keyboard_leds=0;
 uint16_t consumer_key;
 uint16_t last_consumer_key;
 
+// queued keyboard reports, waiting for the endpoint to be free.  `head` is
+// the next report to go out, `tail` the next free slot; both only ever
+// count up (and wrap), so `tail - head` is the number of queued reports
+static uint8_t keyboard_queue[KEYBOARD_QUEUE_SIZE][KEYBOARD_SIZE];
+static volatile uint8_t keyboard_queue_head=0;
+static volatile uint8_t keyboard_queue_tail=0;
+
+// the last keyboard report written to the endpoint (for idle resends)
+static uint8_t keyboard_last_report[KEYBOARD_SIZE];
+
+// queued extra (consumer, system) reports: report id, then 16 bits of data
+static uint8_t extra_queue[EXTRA_QUEUE_SIZE][EXTRA_REPORT_SIZE];
+static volatile uint8_t extra_queue_head=0;
+static volatile uint8_t extra_queue_tail=0;
+
+// how many times a report had to be merged into the newest queued report
+// because the queue was full.  nothing is lost from the host's point of
+// view except the intermediate state, which is why anything sending two
+// reports that both matter (a press and its release) has to check for room
+// first (see usb_keyboard_room())
+uint8_t keyboard_queue_overflows=0;
+uint8_t extra_queue_overflows=0;
+
+#if MAKEFILE_USB_DEBUG
+// buffered debug output.  only usb_debug_putchar() moves `tail`, and only
+// debug_buffer_flush() (with interrupts disabled) moves `head`, so writing
+// never has to wait for (or disable) the interrupt
+static volatile uint8_t debug_buffer[DEBUG_BUFFER_SIZE];
+static volatile uint8_t debug_buffer_head=0;
+static volatile uint8_t debug_buffer_tail=0;
+
+// how many characters were dropped because the buffer was full
+uint8_t debug_buffer_overflows=0;
+#endif
+
+static void keyboard_queue_flush(void);
+static void extra_queue_flush(void);
+#if MAKEFILE_USB_DEBUG
+static void debug_buffer_flush(void);
+#endif
+
 
 /**************************************************************************
  *
@@ -358,11 +510,14 @@ uint8_t usb_configured(void)
 }
 
 
-// perform a single keystroke
+// perform a single keystroke.  the press and the release are queued
+// together, or not at all: if there isn't room for both, nothing is sent
+// (and -1 is returned), so the press is never merged into its release
 int8_t usb_keyboard_press(uint8_t key, uint8_t modifier)
 {
 	int8_t r;
 
+	if (usb_keyboard_room() < 2) return -1;
 	keyboard_modifier_keys = modifier;
 	keyboard_keys[0] = key;
 	r = usb_keyboard_send();
@@ -372,36 +527,41 @@ int8_t usb_keyboard_press(uint8_t key, uint8_t modifier)
 	return usb_keyboard_send();
 }
 
-// send the contents of keyboard_keys and keyboard_modifier_keys
+// how many more keyboard reports can be queued before the next one has to be
+// merged into the newest (doesn't wait for anything)
+uint8_t usb_keyboard_room(void)
+{
+	return KEYBOARD_QUEUE_SIZE
+		- (uint8_t)(keyboard_queue_tail - keyboard_queue_head);
+}
+
+// queue the contents of keyboard_keys and keyboard_modifier_keys to be
+// sent, and return without waiting for the endpoint
 int8_t usb_keyboard_send(void)
 {
-	uint8_t i, intr_state, timeout;
+	uint8_t i, intr_state, *report;
 
 	if (!usb_configuration) return -1;
 	intr_state = SREG;
 	cli();
-	UENUM = KEYBOARD_ENDPOINT;
-	timeout = UDFNUML + 50;
-	while (1) {
-		// are we ready to transmit?
-		if (UEINTX & (1<<RWAL)) break;
-		SREG = intr_state;
-		// has the USB gone offline?
-		if (!usb_configuration) return -1;
-		// have we waited too long?
-		if (UDFNUML == timeout) return -1;
-		// get ready to try checking again
-		intr_state = SREG;
-		cli();
-		UENUM = KEYBOARD_ENDPOINT;
+	if ((uint8_t)(keyboard_queue_tail - keyboard_queue_head)
+			== KEYBOARD_QUEUE_SIZE) {
+		// full: overwrite the newest report, so the host still ends
+		// up with the current state, and in order
+		keyboard_queue_overflows++;
+		report = keyboard_queue[(uint8_t)(keyboard_queue_tail-1)
+					& KEYBOARD_QUEUE_MASK];
+	} else {
+		report = keyboard_queue[keyboard_queue_tail & KEYBOARD_QUEUE_MASK];
+		keyboard_queue_tail++;
 	}
-	UEDATX = keyboard_modifier_keys;
-	UEDATX = 0;
+	report[0] = keyboard_modifier_keys;
+	report[1] = 0;
 	for (i=0; i<6; i++) {
-		UEDATX = keyboard_keys[i];
+		report[i+2] = keyboard_keys[i];
 	}
-	UEINTX = 0x3A;
-	keyboard_idle_count = 0;
+	keyboard_report_changed = 0;
+	keyboard_queue_flush();
 	SREG = intr_state;
 	return 0;
 }
@@ -414,6 +574,70 @@ int8_t usb_keyboard_send(void)
 
 
 
+// Write as many queued keyboard reports as the endpoint has room for.
+// Must be called with interrupts disabled.
+static void keyboard_queue_flush(void)
+{
+	uint8_t i, *report;
+
+	UENUM = KEYBOARD_ENDPOINT;
+	while (keyboard_queue_head != keyboard_queue_tail) {
+		if (!(UEINTX & (1<<RWAL))) return;
+		report = keyboard_queue[keyboard_queue_head & KEYBOARD_QUEUE_MASK];
+		for (i=0; i<KEYBOARD_SIZE; i++) {
+			UEDATX = report[i];
+			keyboard_last_report[i] = report[i];
+		}
+		UEINTX = 0x3A;
+		keyboard_queue_head++;
+		keyboard_idle_count = 0;
+	}
+}
+
+// Write as many queued extra reports as the endpoint has room for.
+// Must be called with interrupts disabled.
+static void extra_queue_flush(void)
+{
+	uint8_t i, *report;
+
+	UENUM = EXTRA_ENDPOINT;
+	while (extra_queue_head != extra_queue_tail) {
+		if (!(UEINTX & (1<<RWAL))) return;
+		report = extra_queue[extra_queue_head & EXTRA_QUEUE_MASK];
+		for (i=0; i<EXTRA_REPORT_SIZE; i++) {
+			UEDATX = report[i];
+		}
+		UEINTX = 0x3A;
+		extra_queue_head++;
+	}
+}
+
+#if MAKEFILE_USB_DEBUG
+// Write as much buffered debug output as the endpoint has room for, in
+// packets padded with zeros (which hid_listen ignores).  Must be called
+// with interrupts disabled.
+static void debug_buffer_flush(void)
+{
+	uint8_t i;
+
+	UENUM = DEBUG_TX_ENDPOINT;
+	while (debug_buffer_head != debug_buffer_tail) {
+		if (!(UEINTX & (1<<RWAL))) return;
+		for (i=0; i<DEBUG_TX_SIZE; i++) {
+			if (debug_buffer_head != debug_buffer_tail) {
+				UEDATX = debug_buffer[debug_buffer_head
+						     & DEBUG_BUFFER_MASK];
+				debug_buffer_head++;
+			} else {
+				UEDATX = 0;
+			}
+		}
+		UEINTX = 0x3A;
+	}
+}
+#endif
+
+
 // USB Device Interrupt - handle all device-level events
 // the transmit buffer flushing is triggered by the start of frame
 //
@@ -432,18 +656,30 @@ ISR(USB_GEN_vect)
 		UECFG1X = EP_SIZE(ENDPOINT0_SIZE) | EP_SINGLE_BUFFER;
 		UEIENX = (1<<RXSTPE);
 		usb_configuration = 0;
+		// anything still queued was meant for the old connection
+		keyboard_queue_head = keyboard_queue_tail;
+		extra_queue_head = extra_queue_tail;
+#if MAKEFILE_USB_DEBUG
+		debug_buffer_head = debug_buffer_tail;
+#endif
         }
 	if ((intbits & (1<<SOFI)) && usb_configuration) {
-		if (keyboard_idle_config && (++div4 & 3) == 0) {
+		keyboard_queue_flush();
+		extra_queue_flush();
+#if MAKEFILE_USB_DEBUG
+		debug_buffer_flush();
+#endif
+		// resend the last report if the host wants that, but never
+		// ahead of something still waiting in the queue
+		if (keyboard_idle_config && (++div4 & 3) == 0
+				&& keyboard_queue_head == keyboard_queue_tail) {
 			UENUM = KEYBOARD_ENDPOINT;
 			if (UEINTX & (1<<RWAL)) {
 				keyboard_idle_count++;
 				if (keyboard_idle_count == keyboard_idle_config) {
 					keyboard_idle_count = 0;
-					UEDATX = keyboard_modifier_keys;
-					UEDATX = 0;
-					for (i=0; i<6; i++) {
-						UEDATX = keyboard_keys[i];
+					for (i=0; i<KEYBOARD_SIZE; i++) {
+						UEDATX = keyboard_last_report[i];
 					}
 					UEINTX = 0x3A;
 				}
@@ -660,39 +896,62 @@ ISR(USB_COM_vect)
 	UECONX = (1<<STALLRQ) | (1<<EPEN);	// stall
 }
 
+#if MAKEFILE_USB_DEBUG
+// buffer a character for the debug console, and return without waiting for
+// the endpoint.  if the buffer is full, the character is dropped
+int8_t usb_debug_putchar(uint8_t c)
+{
+	if (!usb_configuration) return -1;
+	if ((uint8_t)(debug_buffer_tail - debug_buffer_head)
+			== DEBUG_BUFFER_SIZE) {
+		debug_buffer_overflows++;
+		return -1;
+	}
+	debug_buffer[debug_buffer_tail & DEBUG_BUFFER_MASK] = c;
+	debug_buffer_tail++;
+	return 0;
+}
+
+// write whatever debug output the endpoint has room for now, instead of
+// waiting for the next start of frame
+void usb_debug_flush_output(void)
+{
+	uint8_t intr_state;
+
+	intr_state = SREG;
+	cli();
+	debug_buffer_flush();
+	SREG = intr_state;
+}
+#endif
+
+// queue an extra report to be sent, and return without waiting for the
+// endpoint
 int8_t usb_extra_send(uint8_t report_id, uint16_t data)
 {
-	uint8_t intr_state, timeout;
+	uint8_t intr_state, *report;
 
 	if (!usb_configured()) return -1;
 	intr_state = SREG;
 	cli();
-	UENUM = EXTRA_ENDPOINT;
-	timeout = UDFNUML + 50;
-	while (1) {
-		// are we ready to transmit?
-		if (UEINTX & (1<<RWAL)) break;
-		SREG = intr_state;
-		// has the USB gone offline?
-		if (!usb_configured()) return -1;
-		// have we waited too long?
-		if (UDFNUML == timeout) return -1;
-		// get ready to try checking again
-		intr_state = SREG;
-		cli();
-		UENUM = EXTRA_ENDPOINT;
+	if ((uint8_t)(extra_queue_tail - extra_queue_head) == EXTRA_QUEUE_SIZE) {
+		// full: overwrite the newest report (see usb_keyboard_send())
+		extra_queue_overflows++;
+		report = extra_queue[(uint8_t)(extra_queue_tail-1)
+				     & EXTRA_QUEUE_MASK];
+	} else {
+		report = extra_queue[extra_queue_tail & EXTRA_QUEUE_MASK];
+		extra_queue_tail++;
 	}
-
-	UEDATX = report_id;
-        UEDATX = data&0xFF;
-        UEDATX = (data>>8)&0xFF;
-
-	UEINTX = 0x3A;
+	report[0] = report_id;
+	report[1] = data&0xFF;
+	report[2] = (data>>8)&0xFF;
+	extra_queue_flush();
 	SREG = intr_state;
 	return 0;
 }
 
-int8_t usb_extra_consumer_send()
+int8_t usb_extra_consumer_send(void)
 {
 	int result = 0;
 	// don't resend the same key repeatedly if held, only send it once.
@@ -8,19 +8,35 @@ uint8_t usb_configured(void);		// is the USB port configured
 
 int8_t usb_keyboard_press(uint8_t key, uint8_t modifier);
 int8_t usb_keyboard_send(void);
+uint8_t usb_keyboard_room(void);		// free slots in the report queue
 extern uint8_t keyboard_modifier_keys;
 extern uint8_t keyboard_keys[6];
+extern uint8_t keyboard_report_changed;
 extern volatile uint8_t keyboard_leds;
 
 extern uint16_t consumer_key;
 
-// This file does not include the HID debug functions, so these empty
-// macros replace them with nothing, so users can compile code that
-// has calls to these functions.
+// reports are queued and sent in order as the host polls for them; these
+// count how many times a queue was full and the newest report was updated
+// in place instead (so a press and its release, sent back to back, need
+// `usb_keyboard_room() >= 2`, or the host will only see the release)
+extern uint8_t keyboard_queue_overflows;
+extern uint8_t extra_queue_overflows;
+
+// The HID debug console (for PJRC's "hid_listen") is only included if
+// enabled in the makefile.  Otherwise, these empty macros replace the
+// functions with nothing, so users can compile code that has calls to
+// them.
+#if MAKEFILE_USB_DEBUG
+int8_t usb_debug_putchar(uint8_t c);
+void usb_debug_flush_output(void);
+extern uint8_t debug_buffer_overflows;
+#else
 #define usb_debug_putchar(c)
 #define usb_debug_flush_output()
+#endif
 
-int8_t usb_extra_consumer_send();
+int8_t usb_extra_consumer_send(void);
 
 #if 0  // removed in favor of equivalent code elsewhere ::Ben Blazak, 2012::
 
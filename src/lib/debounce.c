@@ -0,0 +1,148 @@
+/* ----------------------------------------------------------------------------
+ * Debounce : code
+ *
+ * Sits between `kb_update_matrix()` (which reads the raw state of the
+ * switches) and the code in `main()` that acts on keys changing state.  All
+ * timing is in timer ticks: each call says how many ticks have passed since
+ * the last one, so a scan that comes late (because the main loop overran)
+ * counts for all the time it covers, instead of for one scan period.
+ *
+ * The debounced state of each row, and which keys in it are still being
+ * debounced, are kept as bitfields (like the matrix itself); rows where
+ * nothing is changing or being debounced are skipped after one comparison.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../keyboard/matrix.h"
+#include "./debounce.h"
+
+// ----------------------------------------------------------------------------
+
+// check options
+#if  DEBOUNCE_ALGORITHM != DEBOUNCE_DEFERRED	\
+  && DEBOUNCE_ALGORITHM != DEBOUNCE_EAGER_PRESS	\
+  && DEBOUNCE_ALGORITHM != DEBOUNCE_INTEGRATING
+	#error "Unknown DEBOUNCE_ALGORITHM (see 'debounce.h')"
+#endif
+#if DEBOUNCE_TICKS < 1 || DEBOUNCE_TICKS > 255
+	#error "DEBOUNCE_TIME must be between 1 and 255 timer ticks long"
+#endif
+#if KB_COLUMNS > 16
+	#error "Expecting at most 16 columns"
+#endif
+
+// ----------------------------------------------------------------------------
+
+static uint16_t _debounced[KB_ROWS];  // debounced state: 1 = pressed
+static uint16_t _pending[KB_ROWS];    // keys whose counters are running
+static uint8_t  _counter[KB_ROWS][KB_COLUMNS];
+
+// ----------------------------------------------------------------------------
+
+/*
+ * Update the debounce state of one key
+ *
+ * Arguments
+ * - `row`, `col`: the key
+ * - `bit`: `(1<<col)`
+ * - `raw`: the raw state of the key's row
+ * - `ticks`: the number of timer ticks since the last scan
+ */
+static inline void update_key( uint8_t row, uint8_t col,
+			       uint16_t bit, uint16_t raw, uint8_t ticks ) {
+	uint8_t * counter = &_counter[row][col];
+
+	#if DEBOUNCE_ALGORITHM == DEBOUNCE_INTEGRATING
+
+		// (saturating, without overflowing)
+		if (raw & bit) {
+			if (ticks < DEBOUNCE_TICKS - *counter)
+				*counter += ticks;
+			else
+				*counter = DEBOUNCE_TICKS;
+		} else {
+			if (ticks < *counter)
+				*counter -= ticks;
+			else
+				*counter = 0;
+		}
+
+		if (*counter == DEBOUNCE_TICKS)
+			_debounced[row] |= bit;
+		else if (*counter == 0)
+			_debounced[row] &= ~bit;
+
+		// at rest when the counter is all the way to the side the key
+		// is on
+		if ( (*counter == DEBOUNCE_TICKS && (_debounced[row] & bit))
+		  || (*counter == 0 && !(_debounced[row] & bit)) )
+			_pending[row] &= ~bit;
+		else
+			_pending[row] |= bit;
+
+	#else  // DEBOUNCE_DEFERRED, DEBOUNCE_EAGER_PRESS
+
+		if ( !((raw ^ _debounced[row]) & bit) ) {
+			// raw state agrees with the debounced state: start over
+			*counter = 0;
+			_pending[row] &= ~bit;
+			return;
+		}
+
+		#if DEBOUNCE_ALGORITHM == DEBOUNCE_EAGER_PRESS
+			if (raw & bit) {
+				// press right away
+				_debounced[row] |= bit;
+				*counter = 0;
+				_pending[row] &= ~bit;
+				return;
+			}
+		#endif
+
+		// (`*counter < DEBOUNCE_TICKS` here, so this can't overflow)
+		if (ticks >= DEBOUNCE_TICKS - *counter) {
+			_debounced[row] ^= bit;
+			*counter = 0;
+			_pending[row] &= ~bit;
+		} else {
+			*counter += ticks;
+			_pending[row] |= bit;
+		}
+
+	#endif
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+ * Arguments
+ * - `raw`: the matrix, as just read by `kb_update_matrix()`
+ * - `debounced`: the matrix to write the debounced state to
+ * - `ticks`: the number of timer ticks since the last call (normally 1; more
+ *   if the main loop overran)
+ */
+void debounce_update( uint16_t raw[KB_ROWS],
+                      uint16_t debounced[KB_ROWS],
+                      uint8_t  ticks ) {
+	for (uint8_t row=0; row<KB_ROWS; row++) {
+		uint16_t active = (raw[row] ^ _debounced[row]) | _pending[row];
+		if (active) {
+			uint16_t bit = 1;
+			for (uint8_t col=0; active; col++, bit<<=1) {
+				if (active & bit) {
+					update_key(row, col, bit, raw[row], ticks);
+					active &= ~bit;
+				}
+			}
+		}
+
+		debounced[row] = _debounced[row];
+	}
+}
+
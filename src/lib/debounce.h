@@ -0,0 +1,59 @@
+/* ----------------------------------------------------------------------------
+ * Debounce : exports
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef LIB__DEBOUNCE_h
+	#define LIB__DEBOUNCE_h
+
+	#include <stdbool.h>
+	#include <stdint.h>
+	#include "../keyboard/matrix.h"
+
+	// --------------------------------------------------------------------
+
+	/*
+	 * algorithms (for `DEBOUNCE_ALGORITHM` in the makefile)
+	 *
+	 * - DEBOUNCE_DEFERRED: a key changes state (either way) only after
+	 *   it has read as changed for `DEBOUNCE_TICKS` ticks in a row
+	 *
+	 * - DEBOUNCE_EAGER_PRESS: a key is pressed on the first scan that
+	 *   sees it go down, and released only after it has read as up for
+	 *   `DEBOUNCE_TICKS` ticks in a row (so chatter while a key settles,
+	 *   after being pressed or released, is ignored)
+	 *
+	 * - DEBOUNCE_INTEGRATING: each key has a counter that goes up while
+	 *   the key reads as down, and down while it reads as up (saturating
+	 *   at 0 and `DEBOUNCE_TICKS`); a key is pressed when its counter
+	 *   reaches `DEBOUNCE_TICKS`, and released when it gets back to 0
+	 *
+	 * All of these count timer ticks, not scans: each scan counts for
+	 * however many ticks have passed since the one before it.  So the
+	 * debounce time stays the same if the main loop overruns a tick.
+	 */
+	#define  DEBOUNCE_DEFERRED     1
+	#define  DEBOUNCE_EAGER_PRESS  2
+	#define  DEBOUNCE_INTEGRATING  3
+
+	#ifndef DEBOUNCE_ALGORITHM
+		#define DEBOUNCE_ALGORITHM MAKEFILE_DEBOUNCE_ALGORITHM
+	#endif
+
+	// the debounce time, in timer ticks (rounded up)
+	// - a timer tick is one scan period (`1/MAKEFILE_SCAN_RATE` seconds)
+	#define  DEBOUNCE_TICKS  \
+		( (MAKEFILE_DEBOUNCE_TIME * MAKEFILE_SCAN_RATE + 999) / 1000 )
+
+	// --------------------------------------------------------------------
+
+	void debounce_update( uint16_t raw[KB_ROWS],
+	                      uint16_t debounced[KB_ROWS],
+	                      uint8_t  ticks );
+
+#endif
+
@@ -43,6 +43,8 @@ static const uint16_t _media_code_lookup_table[] = {
  * - Because of the way USB does things, what this actually does is either add
  *   or remove 'keycode' from the list of currently pressed keys, to be sent at
  *   the end of the current cycle (see main.c)
+ * - If that changes the report, `keyboard_report_changed` is set, so main()
+ *   knows it has something to send
  */
 void _kbfun_press_release(bool press, uint8_t keycode) {
 	// no-op
@@ -50,39 +52,26 @@ void _kbfun_press_release(bool press, uint8_t keycode) {
 		return;
 
 	// modifier keys
+	uint8_t modifier = 0;
 	switch (keycode) {
-		case KEY_LeftControl:  (press)
-				       ? (keyboard_modifier_keys |=  (1<<0))
-				       : (keyboard_modifier_keys &= ~(1<<0));
-				       return;
-		case KEY_LeftShift:    (press)
-				       ? (keyboard_modifier_keys |=  (1<<1))
-				       : (keyboard_modifier_keys &= ~(1<<1));
-				       return;
-		case KEY_LeftAlt:      (press)
-				       ? (keyboard_modifier_keys |=  (1<<2))
-				       : (keyboard_modifier_keys &= ~(1<<2));
-				       return;
-		case KEY_LeftGUI:      (press)
-				       ? (keyboard_modifier_keys |=  (1<<3))
-				       : (keyboard_modifier_keys &= ~(1<<3));
-				       return;
-		case KEY_RightControl: (press)
-				       ? (keyboard_modifier_keys |=  (1<<4))
-				       : (keyboard_modifier_keys &= ~(1<<4));
-				       return;
-		case KEY_RightShift:   (press)
-				       ? (keyboard_modifier_keys |=  (1<<5))
-				       : (keyboard_modifier_keys &= ~(1<<5));
-				       return;
-		case KEY_RightAlt:     (press)
-				       ? (keyboard_modifier_keys |=  (1<<6))
-				       : (keyboard_modifier_keys &= ~(1<<6));
-				       return;
-		case KEY_RightGUI:     (press)
-				       ? (keyboard_modifier_keys |=  (1<<7))
-				       : (keyboard_modifier_keys &= ~(1<<7));
-				       return;
+		case KEY_LeftControl:  modifier = (1<<0); break;
+		case KEY_LeftShift:    modifier = (1<<1); break;
+		case KEY_LeftAlt:      modifier = (1<<2); break;
+		case KEY_LeftGUI:      modifier = (1<<3); break;
+		case KEY_RightControl: modifier = (1<<4); break;
+		case KEY_RightShift:   modifier = (1<<5); break;
+		case KEY_RightAlt:     modifier = (1<<6); break;
+		case KEY_RightGUI:     modifier = (1<<7); break;
+	}
+	if (modifier) {
+		uint8_t modifier_keys = (press)
+				      ? (keyboard_modifier_keys |  modifier)
+				      : (keyboard_modifier_keys & ~modifier);
+		if (modifier_keys != keyboard_modifier_keys) {
+			keyboard_modifier_keys = modifier_keys;
+			keyboard_report_changed = true;
+		}
+		return;
 	}
 
 	// all others
@@ -90,11 +79,13 @@ void _kbfun_press_release(bool press, uint8_t keycode) {
 		if (press) {
 			if (keyboard_keys[i] == 0) {
 				keyboard_keys[i] = keycode;
+				keyboard_report_changed = true;
 				return;
 			}
 		} else {
 			if (keyboard_keys[i] == keycode) {
 				keyboard_keys[i] = 0;
+				keyboard_report_changed = true;
 				return;
 			}
 		}
@@ -18,13 +18,13 @@
 
 // ----------------------------------------------------------------------------
 
-// convenience macros
-#define  LAYER         main_arg_layer
-#define  LAYER_OFFSET  main_arg_layer_offset
-#define  ROW           main_arg_row
-#define  COL           main_arg_col
-#define  IS_PRESSED    main_arg_is_pressed
-#define  WAS_PRESSED   main_arg_was_pressed
+// convenience macros (for functions with an `event` argument)
+#define  LAYER         (event->layer)
+#define  LAYER_OFFSET  (event->layer_offset)
+#define  ROW           (event->row)
+#define  COL           (event->col)
+#define  IS_PRESSED    (event->is_pressed)
+#define  WAS_PRESSED   (event->was_pressed)
 
 // ----------------------------------------------------------------------------
 
@@ -35,10 +35,10 @@
  * [description]
  *   Generate a normal keypress or keyrelease
  */
-void kbfun_press_release(void) {
-	if (!main_arg_trans_key_pressed)
+void kbfun_press_release(struct key_event * event) {
+	if (!(event->flags & KEY_EVENT_TRANSPARENT))
 		main_arg_any_non_trans_key_pressed = true;
-	kbfun_press_release_preserve_sticky();
+	kbfun_press_release_preserve_sticky(event);
 }
 
 /*
@@ -56,7 +56,7 @@ void kbfun_press_release(void) {
  *    modifier key (shift, control, alt, gui) on the sticky layer instead of
  *    defining the key to be transparent for the layer.
  */
-void kbfun_press_release_preserve_sticky(void) {
+void kbfun_press_release_preserve_sticky(struct key_event * event) {
 	uint8_t keycode = kb_layout_get(LAYER, ROW, COL);
 	_kbfun_press_release(IS_PRESSED, keycode);
 }
@@ -68,7 +68,7 @@ void kbfun_press_release_preserve_sticky(void) {
  * [description]
  *   Toggle the key pressed or unpressed
  */
-void kbfun_toggle(void) {
+void kbfun_toggle(struct key_event * event) {
 	uint8_t keycode = kb_layout_get(LAYER, ROW, COL);
 
 	if (_kbfun_is_pressed(keycode))
@@ -85,12 +85,13 @@ void kbfun_toggle(void) {
  *   Execute the key that would have been executed if the current layer was not
  *   active
  */
-void kbfun_transparent(void) {
-	main_arg_trans_key_pressed = true;
+void kbfun_transparent(struct key_event * event) {
+	event->flags |= KEY_EVENT_TRANSPARENT;
 	LAYER_OFFSET++;
-	LAYER = main_layers_peek(LAYER_OFFSET);
+	event->layer_id = main_layers_below(event->layer_id);
+	LAYER = main_layers_get_layer(event->layer_id);
 	main_layers_pressed[ROW][COL] = LAYER;
-	main_exec_key();
+	main_exec_key(event);
 }
 
 
@@ -111,19 +112,19 @@ static void layer_pop(uint8_t local_id) {
 	}
 }
 
-static void layer_push(uint8_t local_id) {
+static void layer_push(struct key_event * event, uint8_t local_id) {
 	uint8_t keycode = kb_layout_get(LAYER, ROW, COL);
 	layer_pop(local_id);
 	// Only the topmost layer on the stack should be in sticky once state, pop
 	//  the top layer if it is in sticky once state
 	uint8_t topSticky = main_layers_peek_sticky(0);
 	if (topSticky == eStickyOnceDown || topSticky == eStickyOnceUp) {
-		main_layers_pop_id(main_layers_peek(0));
+		main_layers_pop_id(main_layers_peek_id(0));
 	}
 	layer_ids[local_id] = main_layers_push(keycode, eStickyNone);
 }
 
-static void layer_sticky(uint8_t local_id) {
+static void layer_sticky(struct key_event * event, uint8_t local_id) {
 	uint8_t keycode = kb_layout_get(LAYER, ROW, COL);
 	if (IS_PRESSED) {
 		uint8_t topLayer = main_layers_peek(0);
@@ -159,11 +160,11 @@ static void layer_sticky(uint8_t local_id) {
 	}
 }
 
-static void layer_toggle(uint8_t local_id) {
+static void layer_toggle(struct key_event * event, uint8_t local_id) {
 	if (layer_ids[local_id] != 0) {
 		layer_pop(local_id);
 	} else {
-		layer_push(local_id);
+		layer_push(event, local_id);
 	}
 }
 
@@ -175,8 +176,8 @@ static void layer_toggle(uint8_t local_id) {
  *   Push a layer element containing the layer value specified in the keymap to
  *   the top of the stack, and record the id of that layer element
  */
-void kbfun_layer_push_1(void) {
-	layer_push(1);
+void kbfun_layer_push_1(struct key_event * event) {
+	layer_push(event, 1);
 }
 
 /*
@@ -214,8 +215,8 @@ void kbfun_layer_push_1(void) {
  *      state when the layer sticky key was pressed again. The layer will be
  *      popped if the function is invoked on a subsequent keypress.
  */
-void kbfun_layer_sticky_1  (void) {
-	layer_sticky(1);
+void kbfun_layer_sticky_1  (struct key_event * event) {
+	layer_sticky(event, 1);
 }
 
 /*
@@ -227,7 +228,7 @@ void kbfun_layer_sticky_1  (void) {
  *   out of the layer stack (no matter where it is in the stack, without
  *   touching any other elements)
  */
-void kbfun_layer_pop_1(void) {
+void kbfun_layer_pop_1(struct key_event * event) {
 	layer_pop(1);
 }
 
@@ -239,8 +240,8 @@ void kbfun_layer_pop_1(void) {
  *   If the layer element is already in the layer stack, pop it.  Otherwise,
  *   push the layer element to the top of the stack.
  */
-void kbfun_layer_toggle_1(void) {
-	layer_toggle(1);
+void kbfun_layer_toggle_1(struct key_event * event) {
+	layer_toggle(event, 1);
 }
 
 /*
@@ -250,8 +251,8 @@ void kbfun_layer_toggle_1(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_2(void) {
-	layer_push(2);
+void kbfun_layer_push_2(struct key_event * event) {
+	layer_push(event, 2);
 }
 
 /*
@@ -261,8 +262,8 @@ void kbfun_layer_push_2(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_2  (void) {
-	layer_sticky(2);
+void kbfun_layer_sticky_2  (struct key_event * event) {
+	layer_sticky(event, 2);
 }
 
 /*
@@ -272,7 +273,7 @@ void kbfun_layer_sticky_2  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_2(void) {
+void kbfun_layer_pop_2(struct key_event * event) {
 	layer_pop(2);
 }
 
@@ -283,8 +284,8 @@ void kbfun_layer_pop_2(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_2(void) {
-	layer_toggle(2);
+void kbfun_layer_toggle_2(struct key_event * event) {
+	layer_toggle(event, 2);
 }
 
 /*
@@ -294,8 +295,8 @@ void kbfun_layer_toggle_2(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_3(void) {
-	layer_push(3);
+void kbfun_layer_push_3(struct key_event * event) {
+	layer_push(event, 3);
 }
 
 /*
@@ -305,8 +306,8 @@ void kbfun_layer_push_3(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_3  (void) {
-	layer_sticky(3);
+void kbfun_layer_sticky_3  (struct key_event * event) {
+	layer_sticky(event, 3);
 }
 
 /*
@@ -316,7 +317,7 @@ void kbfun_layer_sticky_3  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_3(void) {
+void kbfun_layer_pop_3(struct key_event * event) {
 	layer_pop(3);
 }
 
@@ -327,8 +328,8 @@ void kbfun_layer_pop_3(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_3(void) {
-	layer_toggle(3);
+void kbfun_layer_toggle_3(struct key_event * event) {
+	layer_toggle(event, 3);
 }
 
 /*
@@ -338,8 +339,8 @@ void kbfun_layer_toggle_3(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_4(void) {
-	layer_push(4);
+void kbfun_layer_push_4(struct key_event * event) {
+	layer_push(event, 4);
 }
 
 /*
@@ -349,8 +350,8 @@ void kbfun_layer_push_4(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_4  (void) {
-	layer_sticky(4);
+void kbfun_layer_sticky_4  (struct key_event * event) {
+	layer_sticky(event, 4);
 }
 
 /*
@@ -360,7 +361,7 @@ void kbfun_layer_sticky_4  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_4(void) {
+void kbfun_layer_pop_4(struct key_event * event) {
 	layer_pop(4);
 }
 
@@ -371,8 +372,8 @@ void kbfun_layer_pop_4(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_4(void) {
-	layer_toggle(4);
+void kbfun_layer_toggle_4(struct key_event * event) {
+	layer_toggle(event, 4);
 }
 
 /*
@@ -382,8 +383,8 @@ void kbfun_layer_toggle_4(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_5(void) {
-	layer_push(5);
+void kbfun_layer_push_5(struct key_event * event) {
+	layer_push(event, 5);
 }
 
 /*
@@ -393,8 +394,8 @@ void kbfun_layer_push_5(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_5  (void) {
-	layer_sticky(5);
+void kbfun_layer_sticky_5  (struct key_event * event) {
+	layer_sticky(event, 5);
 }
 
 /*
@@ -404,7 +405,7 @@ void kbfun_layer_sticky_5  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_5(void) {
+void kbfun_layer_pop_5(struct key_event * event) {
 	layer_pop(5);
 }
 
@@ -415,8 +416,8 @@ void kbfun_layer_pop_5(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_5(void) {
-	layer_toggle(5);
+void kbfun_layer_toggle_5(struct key_event * event) {
+	layer_toggle(event, 5);
 }
 
 /*
@@ -426,8 +427,8 @@ void kbfun_layer_toggle_5(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_6(void) {
-	layer_push(6);
+void kbfun_layer_push_6(struct key_event * event) {
+	layer_push(event, 6);
 }
 
 /*
@@ -437,8 +438,8 @@ void kbfun_layer_push_6(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_6  (void) {
-	layer_sticky(6);
+void kbfun_layer_sticky_6  (struct key_event * event) {
+	layer_sticky(event, 6);
 }
 
 /*
@@ -448,7 +449,7 @@ void kbfun_layer_sticky_6  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_6(void) {
+void kbfun_layer_pop_6(struct key_event * event) {
 	layer_pop(6);
 }
 
@@ -459,8 +460,8 @@ void kbfun_layer_pop_6(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_6(void) {
-	layer_toggle(6);
+void kbfun_layer_toggle_6(struct key_event * event) {
+	layer_toggle(event, 6);
 }
 
 /*
@@ -470,8 +471,8 @@ void kbfun_layer_toggle_6(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_7(void) {
-	layer_push(7);
+void kbfun_layer_push_7(struct key_event * event) {
+	layer_push(event, 7);
 }
 
 /*
@@ -481,8 +482,8 @@ void kbfun_layer_push_7(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_7  (void) {
-	layer_sticky(7);
+void kbfun_layer_sticky_7  (struct key_event * event) {
+	layer_sticky(event, 7);
 }
 
 /*
@@ -492,7 +493,7 @@ void kbfun_layer_sticky_7  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_7(void) {
+void kbfun_layer_pop_7(struct key_event * event) {
 	layer_pop(7);
 }
 
@@ -503,8 +504,8 @@ void kbfun_layer_pop_7(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_7(void) {
-	layer_toggle(7);
+void kbfun_layer_toggle_7(struct key_event * event) {
+	layer_toggle(event, 7);
 }
 
 /*
@@ -514,8 +515,8 @@ void kbfun_layer_toggle_7(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_8(void) {
-	layer_push(8);
+void kbfun_layer_push_8(struct key_event * event) {
+	layer_push(event, 8);
 }
 
 /*
@@ -525,8 +526,8 @@ void kbfun_layer_push_8(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_8  (void) {
-	layer_sticky(8);
+void kbfun_layer_sticky_8  (struct key_event * event) {
+	layer_sticky(event, 8);
 }
 
 /*
@@ -536,7 +537,7 @@ void kbfun_layer_sticky_8  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_8(void) {
+void kbfun_layer_pop_8(struct key_event * event) {
 	layer_pop(8);
 }
 
@@ -547,8 +548,8 @@ void kbfun_layer_pop_8(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_8(void) {
-	layer_toggle(8);
+void kbfun_layer_toggle_8(struct key_event * event) {
+	layer_toggle(event, 8);
 }
 
 /*
@@ -558,8 +559,8 @@ void kbfun_layer_toggle_8(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_9(void) {
-	layer_push(9);
+void kbfun_layer_push_9(struct key_event * event) {
+	layer_push(event, 9);
 }
 
 /*
@@ -569,8 +570,8 @@ void kbfun_layer_push_9(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_9  (void) {
-	layer_sticky(9);
+void kbfun_layer_sticky_9  (struct key_event * event) {
+	layer_sticky(event, 9);
 }
 
 /*
@@ -580,7 +581,7 @@ void kbfun_layer_sticky_9  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_9(void) {
+void kbfun_layer_pop_9(struct key_event * event) {
 	layer_pop(9);
 }
 
@@ -591,8 +592,8 @@ void kbfun_layer_pop_9(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_9(void) {
-	layer_toggle(9);
+void kbfun_layer_toggle_9(struct key_event * event) {
+	layer_toggle(event, 9);
 }
 
 /*
@@ -602,8 +603,8 @@ void kbfun_layer_toggle_9(void) {
  * [description]
  *   See the description of kbfun_layer_push_1()
  */
-void kbfun_layer_push_10(void) {
-	layer_push(10);
+void kbfun_layer_push_10(struct key_event * event) {
+	layer_push(event, 10);
 }
 
 /*
@@ -613,8 +614,8 @@ void kbfun_layer_push_10(void) {
  * [description]
  *   See the description of kbfun_layer_sticky_1()
  */
-void kbfun_layer_sticky_10  (void) {
-	layer_sticky(10);
+void kbfun_layer_sticky_10  (struct key_event * event) {
+	layer_sticky(event, 10);
 }
 
 /*
@@ -624,7 +625,7 @@ void kbfun_layer_sticky_10  (void) {
  * [description]
  *   See the description of kbfun_layer_pop_1()
  */
-void kbfun_layer_pop_10(void) {
+void kbfun_layer_pop_10(struct key_event * event) {
 	layer_pop(10);
 }
 
@@ -635,8 +636,8 @@ void kbfun_layer_pop_10(void) {
  * [description]
  *   See the description of kbfun_layer_toggle_1()
  */
-void kbfun_layer_toggle_10(void) {
-	layer_toggle(10);
+void kbfun_layer_toggle_10(struct key_event * event) {
+	layer_toggle(event, 10);
 }
 
 /* ----------------------------------------------------------------------------
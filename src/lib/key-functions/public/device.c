@@ -7,8 +7,16 @@
  * ------------------------------------------------------------------------- */
 
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include "../../../lib-other/pjrc/usb_keyboard/usb_keyboard.h"
+#include "../../../lib/usb/usage-page/keyboard.h"
+#include "../../../lib/profile.h"
+#include "../../../lib/timer.h"
+#include "../../../main.h"
 #include "../public.h"
 
 
@@ -23,7 +31,32 @@
  * [description]
  *   For reflashing the controller
  */
-void kbfun_jump_to_bootloader(void);
+void kbfun_jump_to_bootloader(struct key_event * event);
+
+/*
+ * [name]
+ *   Dump the profiler table
+ *
+ * [description]
+ *   On keypress, type out one line per used slot of the profiler table (see
+ *   "lib/profile.h"), then reset it.  All numbers are in hex:
+ *
+ *       <slot> <count> <min> <max> <average>
+ *
+ *   Times are in profiler ticks (CPU cycles, on the Teensy).
+ *
+ * [note]
+ *   This busy-waits, inside the key function, for the host to take each
+ *   keystroke (a few ms each), so the keyboard isn't scanned while the table
+ *   is being typed.  Keys that were held before stay held (their state is
+ *   saved, and sent again afterwards); changes during the dump are picked up
+ *   on the next scan.  If the host stops taking reports for about 50 ms, the
+ *   rest of the dump is skipped (and the table isn't reset).
+ *
+ * [note]
+ *   Does nothing if the profiler is disabled (in the makefile).
+ */
+void kbfun_profile_dump(struct key_event * event);
 
 
 // ----------------------------------------------------------------------------
@@ -32,7 +65,7 @@ void kbfun_jump_to_bootloader(void);
 
 // from PJRC (slightly modified)
 // <http://www.pjrc.com/teensy/jump_to_bootloader.html>
-void kbfun_jump_to_bootloader(void) {
+void kbfun_jump_to_bootloader(struct key_event * event) {
 	// --- for all Teensy boards ---
 
 	cli();
@@ -58,7 +91,100 @@ void kbfun_jump_to_bootloader(void) {
 #else
 // ----------------------------------------------------------------------------
 
-void kbfun_jump_to_bootloader(void) {}
+void kbfun_jump_to_bootloader(struct key_event * event) {}
+
+
+// ----------------------------------------------------------------------------
+#endif
+// ----------------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------------
+#if MAKEFILE_PROFILE
+// ----------------------------------------------------------------------------
+
+// how long to wait for room in the report queue, before giving up
+#define  TYPE_TIMEOUT  (TIMER_FREQ / 20 + 1)  // about 50 ms, in timer ticks
+
+/* type one key (press and release), with nothing else held
+ *
+ * returns
+ * - success: 0
+ * - failure: the host didn't take a report for `TYPE_TIMEOUT`
+ */
+static uint8_t _type(uint8_t keycode) {
+	uint16_t start = timer_get_ticks();
+
+	// wait for room for the whole keystroke (see `usb_keyboard_press()`)
+	while (usb_keyboard_room() < 2)
+		if ( ! usb_configured()
+		     || (uint16_t)(timer_get_ticks() - start) > TYPE_TIMEOUT )
+			return 1;
+
+	return usb_keyboard_press(keycode, 0) ? 1 : 0;
+}
+
+static uint8_t _type_hex(uint16_t value, uint8_t digits) {
+	while (digits--) {
+		uint8_t digit = (value >> (digits*4)) & 0xF;
+		uint8_t keycode = (digit == 0) ? KEY_0_RightParenthesis
+		                : (digit < 10) ? KEY_1_Exclamation + digit - 1
+		                :                KEY_a_A + digit - 10;
+		if (_type(keycode))
+			return 1;
+	}
+	return 0;
+}
+
+/* type the table, one line per used slot
+ *
+ * returns
+ * - success: 0
+ * - failure: see `_type()`
+ */
+static uint8_t _dump(void) {
+	for (uint8_t slot=0; slot<PROFILE_SLOTS; slot++) {
+		struct profile_entry * e = &profile_table[slot];
+		if (! e->count)
+			continue;
+
+		if ( _type_hex(slot, 1)
+		     || _type(KEY_Spacebar) || _type_hex(e->count, 4)
+		     || _type(KEY_Spacebar) || _type_hex(e->min, 4)
+		     || _type(KEY_Spacebar) || _type_hex(e->max, 4)
+		     || _type(KEY_Spacebar) || _type_hex(e->total / e->count, 4)
+		     || _type(KEY_ReturnEnter) )
+			return 1;
+	}
+	return 0;
+}
+
+void kbfun_profile_dump(struct key_event * event) {
+	if (! event->is_pressed)
+		return;
+
+	// `usb_keyboard_press()` sends its own reports (and clears these), so
+	// save what's held, and send it again when we're done
+	uint8_t modifier_keys = keyboard_modifier_keys;
+	uint8_t keys[sizeof(keyboard_keys)];
+	memcpy(keys, keyboard_keys, sizeof(keys));
+
+	bool done = ! _dump();
+
+	keyboard_modifier_keys = modifier_keys;
+	memcpy(keyboard_keys, keys, sizeof(keys));
+	keyboard_report_changed = 1;
+
+	if (done)
+		profile_reset();
+}
+
+
+// ----------------------------------------------------------------------------
+#else
+// ----------------------------------------------------------------------------
+
+void kbfun_profile_dump(struct key_event * event) {}
 
 
 // ----------------------------------------------------------------------------
@@ -18,13 +18,13 @@
 
 // ----------------------------------------------------------------------------
 
-// convenience macros
-#define  LAYER         main_arg_layer
-#define  LAYER_OFFSET  main_arg_layer_offset
-#define  ROW           main_arg_row
-#define  COL           main_arg_col
-#define  IS_PRESSED    main_arg_is_pressed
-#define  WAS_PRESSED   main_arg_was_pressed
+// convenience macros (for functions with an `event` argument)
+#define  LAYER         (event->layer)
+#define  LAYER_OFFSET  (event->layer_offset)
+#define  ROW           (event->row)
+#define  COL           (event->col)
+#define  IS_PRESSED    (event->is_pressed)
+#define  WAS_PRESSED   (event->was_pressed)
 
 
 // ----------------------------------------------------------------------------
@@ -38,9 +38,9 @@
  *   Generate a 'shift' press or release before the normal keypress or
  *   keyrelease
  */
-void kbfun_shift_press_release(void) {
+void kbfun_shift_press_release(struct key_event * event) {
 	_kbfun_press_release(IS_PRESSED, KEY_LeftShift);
-	kbfun_press_release();
+	kbfun_press_release(event);
 }
 
 /*
@@ -57,8 +57,13 @@ void kbfun_shift_press_release(void) {
  *   wil be released so that capslock will register properly when pressed.
  *   Capslock will then be pressed and released, and the original state of the
  *   shifts will be restored
+ *
+ * [note]
+ *   If the USB report queue doesn't have room for both the press and the
+ *   release of capslock, capslock isn't sent at all (otherwise the press
+ *   would be merged into the release, and the host would never see it)
  */
-void kbfun_2_keys_capslock_press_release(void) {
+void kbfun_2_keys_capslock_press_release(struct key_event * event) {
 	static uint8_t keys_pressed;
 	static bool lshift_pressed;
 	static bool rshift_pressed;
@@ -70,8 +75,9 @@ void kbfun_2_keys_capslock_press_release(void) {
 	// take care of the key that was actually pressed
 	_kbfun_press_release(IS_PRESSED, keycode);
 
-	// take care of capslock (only on the press of the 2nd key)
-	if (keys_pressed == 1 && IS_PRESSED) {
+	// take care of capslock (only on the press of the 2nd key, and only if
+	// both reports will make it to the host)
+	if (keys_pressed == 1 && IS_PRESSED && usb_keyboard_room() >= 2) {
 		// save the state of left and right shift
 		lshift_pressed = _kbfun_is_pressed(KEY_LeftShift);
 		rshift_pressed = _kbfun_is_pressed(KEY_RightShift);
@@ -101,6 +107,9 @@ void kbfun_2_keys_capslock_press_release(void) {
 
 static uint8_t numpad_layer_id;
 
+// - the caller must make sure there's room in the USB report queue for both
+//   reports (see `numpad_can_toggle()`), or the press will be merged into the
+//   release
 static inline void numpad_toggle_numlock(void) {
 	_kbfun_press_release(true, KEY_LockingNumLock);
 	usb_keyboard_send();
@@ -108,6 +117,10 @@ static inline void numpad_toggle_numlock(void) {
 	usb_keyboard_send();
 }
 
+static inline bool numpad_can_toggle(void) {
+	return usb_keyboard_room() >= 2;
+}
+
 /*
  * [name]
  *   Numpad on
@@ -120,9 +133,15 @@ static inline void numpad_toggle_numlock(void) {
  * [note]
  *   Meant to be assigned (along with "numpad off") instead of a normal numlock
  *   key
+ *
+ * [note]
+ *   Does nothing (leaving the layer stack alone too, so it stays in step with
+ *   numlock) if the USB report queue is too full to send the numlock press
+ *   and release
  */
-void kbfun_layer_push_numpad(void) {
+void kbfun_layer_push_numpad(struct key_event * event) {
 	uint8_t keycode = kb_layout_get(LAYER, ROW, COL);
+	if (! numpad_can_toggle()) return;
 	main_layers_pop_id(numpad_layer_id);
 	numpad_layer_id = main_layers_push(keycode, eStickyNone);
 	numpad_toggle_numlock();
@@ -140,8 +159,14 @@ void kbfun_layer_push_numpad(void) {
  * [note]
  *   Meant to be assigned (along with "numpad on") instead of a normal numlock
  *   key
+ *
+ * [note]
+ *   Does nothing (leaving the layer stack alone too, so it stays in step with
+ *   numlock) if the USB report queue is too full to send the numlock press
+ *   and release
  */
-void kbfun_layer_pop_numpad(void) {
+void kbfun_layer_pop_numpad(struct key_event * event) {
+	if (! numpad_can_toggle()) return;
 	main_layers_pop_id(numpad_layer_id);
 	numpad_layer_id = 0;
 	numpad_toggle_numlock();
@@ -156,7 +181,7 @@ void kbfun_layer_pop_numpad(void) {
  *   previous track
  *
  */
-void kbfun_mediakey_press_release(void) {
+void kbfun_mediakey_press_release(struct key_event * event) {
 	uint8_t keycode = kb_layout_get(LAYER, ROW, COL);
 	_kbfun_mediakey_press_release(IS_PRESSED, keycode);
 }
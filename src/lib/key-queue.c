@@ -0,0 +1,75 @@
+/* ----------------------------------------------------------------------------
+ * key queue
+ *
+ * See "./key-queue.h".
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "./key-queue.h"
+
+// ----------------------------------------------------------------------------
+
+#if (KEY_QUEUE_SIZE & (KEY_QUEUE_SIZE - 1)) || KEY_QUEUE_SIZE > 128
+	#error "`KEY_QUEUE_SIZE` must be a power of 2, and at most 128"
+#endif
+
+#define MASK (KEY_QUEUE_SIZE - 1)
+
+// ----------------------------------------------------------------------------
+
+static struct key_queue_entry _queue[KEY_QUEUE_SIZE];
+
+volatile uint8_t key_queue_head;
+volatile uint8_t key_queue_tail;
+
+uint8_t  key_queue_high_water;
+uint16_t key_queue_drops;
+
+// ----------------------------------------------------------------------------
+
+/*
+ * returns
+ * - success: 0
+ * - failure: 1 (the queue is full; nothing was pushed)
+ */
+uint8_t key_queue_push(struct key_queue_entry * entry) {
+	uint8_t head = key_queue_head;
+	uint8_t depth = head - key_queue_tail;
+
+	if (depth == KEY_QUEUE_SIZE) {
+		key_queue_drops++;
+		return 1;  // failure
+	}
+
+	_queue[head & MASK] = *entry;
+	key_queue_head = head + 1;  // publish (after the entry is written)
+
+	if (depth + 1 > key_queue_high_water)
+		key_queue_high_water = depth + 1;
+
+	return 0;  // success
+}
+
+/*
+ * returns
+ * - success: 0 (the oldest entry was copied into `entry`, and removed)
+ * - failure: 1 (the queue is empty)
+ */
+uint8_t key_queue_pop(struct key_queue_entry * entry) {
+	uint8_t tail = key_queue_tail;
+
+	if (tail == key_queue_head)
+		return 1;  // failure
+
+	*entry = _queue[tail & MASK];
+	key_queue_tail = tail + 1;  // free the slot (after it's been read)
+
+	return 0;  // success
+}
+
@@ -0,0 +1,66 @@
+/* ----------------------------------------------------------------------------
+ * key queue : exports
+ *
+ * A small ring buffer of (debounced) key events, each with the time it was
+ * scanned, between the scan stage of the main loop (which pushes) and the
+ * processing stage (which pops).
+ *
+ * - Single producer, single consumer: `head` is only written by
+ *   `key_queue_push()`, and `tail` only by `key_queue_pop()`, and both are 8
+ *   bits, so one side may be moved to an interrupt without any locking.
+ * - When the queue is full, `key_queue_push()` refuses the event; it's up to
+ *   the producer to try again later.  The main loop does, on every scan
+ *   until there's room, by comparing the debounced state with what it has
+ *   queued so far.  So:
+ *     - A retried event is stamped with the time of the scan that finally
+ *       pushed it, not the time the key changed.
+ *     - A key that changes and changes back while the queue stays full (a
+ *       press and its release, say) is never queued at all: by the time
+ *       there's room, there's no difference left to push.
+ *   `key_queue_drops` counts refused pushes (one per scan while the queue
+ *   stays full), so it's nonzero whenever either of these may have
+ *   happened, but it isn't a count of lost keys.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef LIB__KEY_QUEUE_h
+	#define LIB__KEY_QUEUE_h
+
+	#include <stdbool.h>
+	#include <stdint.h>
+
+	// --------------------------------------------------------------------
+
+	#define KEY_QUEUE_SIZE 32  // must be a power of 2, and at most 128
+
+	// --------------------------------------------------------------------
+
+	struct key_queue_entry {
+		uint8_t  row;
+		uint8_t  col;
+		bool     is_pressed;
+		uint16_t time;  // when the key changed (in timer ticks)
+	};
+
+	extern volatile uint8_t key_queue_head;  // (free running) index of
+						 //   the next entry to push
+	extern volatile uint8_t key_queue_tail;  // ... to pop
+
+	extern uint8_t  key_queue_high_water;  // the most entries ever queued
+	extern uint16_t key_queue_drops;       // pushes refused (queue full;
+					       //   see above)
+
+	// --------------------------------------------------------------------
+
+	uint8_t key_queue_push (struct key_queue_entry * entry);
+	uint8_t key_queue_pop  (struct key_queue_entry * entry);
+
+	// the number of entries waiting
+	#define key_queue_depth() ((uint8_t)(key_queue_head - key_queue_tail))
+
+#endif
+
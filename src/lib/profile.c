@@ -0,0 +1,63 @@
+/* ----------------------------------------------------------------------------
+ * profiler
+ *
+ * See "./profile.h".
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "./profile.h"
+
+// ----------------------------------------------------------------------------
+#if MAKEFILE_PROFILE
+// ----------------------------------------------------------------------------
+
+struct profile_entry profile_table[PROFILE_SLOTS];
+bool profile__discard;
+
+// ----------------------------------------------------------------------------
+
+void profile_init(void) {
+	_profile_timer_init();
+	profile_reset();
+}
+
+void profile_reset(void) {
+	for (uint8_t slot=0; slot<PROFILE_SLOTS; slot++) {
+		profile_table[slot].min = UINT16_MAX;
+		profile_table[slot].max = 0;
+		profile_table[slot].total = 0;
+		profile_table[slot].count = 0;
+	}
+	profile__discard = true;
+}
+
+void profile_record(uint8_t slot, uint16_t ticks) {
+	if (profile__discard)
+		return;
+
+	struct profile_entry * e = &profile_table[slot];
+
+	if (ticks < e->min)
+		e->min = ticks;
+	if (ticks > e->max)
+		e->max = ticks;
+
+	// keep the average (roughly) the same, but make room for more
+	if (e->count == UINT16_MAX) {
+		e->total >>= 1;
+		e->count >>= 1;
+	}
+	e->total += ticks;
+	e->count++;
+}
+
+// ----------------------------------------------------------------------------
+#endif
+// ----------------------------------------------------------------------------
+
@@ -0,0 +1,85 @@
+/* ----------------------------------------------------------------------------
+ * profiler : exports
+ *
+ * Times sections of code (in ticks of a free running hardware timer), and
+ * keeps the min, max, and average time taken by each in a small table in
+ * SRAM, for `kbfun_profile_dump()` (or a debugger) to read.
+ *
+ * - Enabled by setting `PROFILE` to 1 in the makefile; otherwise every macro
+ *   here compiles to nothing.
+ * - Usage:
+ *
+ *       profile_enter(SLOT);
+ *       // ... code to time ...
+ *       profile_exit(SLOT);
+ *
+ *   where `SLOT` is a constant (or a macro for one) less than
+ *   `PROFILE_SLOTS`.  `profile_enter()` declares a variable, so the two must
+ *   be in the same block, and a slot can be entered only once per block.
+ * - Times include any interrupts that ran in between, and wrap around if
+ *   they're longer than the timer's range (see the board specific header).
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef LIB__PROFILE_h
+	#define LIB__PROFILE_h
+
+	#include <stdbool.h>
+	#include <stdint.h>
+
+	// --------------------------------------------------------------------
+
+	#define PROFILE_SLOTS 8
+
+	// --------------------------------------------------------------------
+
+	#if MAKEFILE_PROFILE
+
+		// board specific: `_profile_timer_init()`,
+		// `_profile_timer_read()`, and `PROFILE_TICK_FREQ`
+		#include "./variable-include.h"
+		#define INCLUDE EXP_STR( ./profile/MAKEFILE_BOARD.h )
+		#include INCLUDE
+
+		struct profile_entry {
+			uint16_t min;    // in ticks
+			uint16_t max;    // in ticks
+			uint32_t total;  // in ticks, for `count` runs
+			uint16_t count;
+		};
+
+		extern struct profile_entry profile_table[PROFILE_SLOTS];
+		extern bool profile__discard;
+
+		void profile_init   (void);
+		void profile_reset  (void);
+		void profile_record (uint8_t slot, uint16_t ticks);
+
+		#define profile_enter(slot) \
+			uint16_t profile__start_##slot = _profile_timer_read()
+		#define profile_exit(slot) \
+			profile_record( (slot), \
+			                _profile_timer_read() \
+			                - profile__start_##slot )
+
+		// to be called before entering any slot, once per main loop:
+		// measurements that were running when the table was reset
+		// (until now) are thrown away
+		#define profile_loop() (profile__discard = false)
+
+	#else
+
+		#define profile_init()
+		#define profile_reset()
+		#define profile_enter(slot)
+		#define profile_exit(slot)
+		#define profile_loop()
+
+	#endif
+
+#endif
+
@@ -0,0 +1,33 @@
+/* ----------------------------------------------------------------------------
+ * profiler : host (simulation) specific exports
+ *
+ * - Ticks are nanoseconds of the host's monotonic clock, so times wrap around
+ *   after 2^16 ns (about 65 us).  They're only useful for comparing one
+ *   version of the code with another on the same machine.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef LIB__PROFILE__HOST_h
+	#define LIB__PROFILE__HOST_h
+
+	#include <stdint.h>
+	#include <time.h>
+
+	// --------------------------------------------------------------------
+
+	#define PROFILE_TICK_FREQ 1000000000  // in Hz
+
+	#define _profile_timer_init()
+
+	static inline uint16_t _profile_timer_read(void) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return now.tv_nsec;
+	}
+
+#endif
+
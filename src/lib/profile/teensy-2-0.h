@@ -0,0 +1,31 @@
+/* ----------------------------------------------------------------------------
+ * profiler : Teensy 2.0 specific exports
+ *
+ * - Uses Timer3 (otherwise unused), counting CPU cycles (no prescaler), so
+ *   times wrap around after 2^16 cycles (4.096 ms at 16 MHz).
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef LIB__PROFILE__TEENSY_2_0_h
+	#define LIB__PROFILE__TEENSY_2_0_h
+
+	#include <avr/io.h>
+
+	// --------------------------------------------------------------------
+
+	#define PROFILE_TICK_FREQ F_CPU  // in Hz
+
+	// normal mode, clk/1 (datasheet section 14.10)
+	#define _profile_timer_init() do {	\
+			TCCR3A = 0;		\
+			TCCR3B = (1<<CS30);	\
+			} while(0)
+
+	#define _profile_timer_read() (TCNT3)
+
+#endif
+
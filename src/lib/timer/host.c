@@ -0,0 +1,55 @@
+/* ----------------------------------------------------------------------------
+ * Timer : host (simulation) specific code
+ *
+ * - There's no real time on the host: time only passes when something waits
+ *   for it.  Every call to `timer_wait_next()` moves on by exactly one tick,
+ *   so the main loop never waits, does exactly one scan per tick, and never
+ *   sees a scan come due in the middle of processing.  This keeps runs
+ *   deterministic.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+// ----------------------------------------------------------------------------
+// conditional compile
+#if MAKEFILE_BOARD == host
+// ----------------------------------------------------------------------------
+
+
+#include <stdint.h>
+#include "./host.h"
+
+// ----------------------------------------------------------------------------
+
+static uint16_t _timer_ticks;
+
+// ----------------------------------------------------------------------------
+
+void timer_init(void) {
+	_timer_ticks = 0;
+}
+
+/*
+ * Returns
+ * - the number of ticks since `timer_init()`, mod 2^16
+ */
+uint16_t timer_get_ticks(void) {
+	return _timer_ticks;
+}
+
+/*
+ * Returns
+ * - the next tick, right away (`tick` is always the current one, or earlier)
+ */
+uint16_t timer_wait_next(uint16_t tick) {
+	return ++_timer_ticks;
+}
+
+
+// ----------------------------------------------------------------------------
+#endif
+// ----------------------------------------------------------------------------
+
@@ -0,0 +1,93 @@
+/* ----------------------------------------------------------------------------
+ * Very simple Teensy 2.0 timer library : code
+ *
+ * - Uses Timer/Counter0 in CTC mode (datasheet section 13.7.2) to count
+ *   "ticks" at `TIMER_FREQ`.  The count wraps around every 2^16 ticks, so
+ *   users should only ever look at the difference between two counts.
+ * - Timer/Counter1 is used for the LEDs (see "teensy-2-0.md" in the keyboard
+ *   controller directory), and Timer/Counter3 is left free.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+// ----------------------------------------------------------------------------
+// conditional compile
+#if MAKEFILE_BOARD == teensy-2-0
+// ----------------------------------------------------------------------------
+
+
+#include <stdint.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "./teensy-2-0.h"
+
+// ----------------------------------------------------------------------------
+
+// pick the smallest prescaler that lets an 8-bit counter reach `TIMER_FREQ`
+// (datasheet section 13.9.2, table 13-9)
+#if   (F_CPU / 8 / TIMER_FREQ) <= 256
+	#define  PRESCALE       8
+	#define  CLOCK_SELECT  ((1<<CS01))
+#elif (F_CPU / 64 / TIMER_FREQ) <= 256
+	#define  PRESCALE       64
+	#define  CLOCK_SELECT  ((1<<CS01)|(1<<CS00))
+#elif (F_CPU / 256 / TIMER_FREQ) <= 256
+	#define  PRESCALE       256
+	#define  CLOCK_SELECT  ((1<<CS02))
+#elif (F_CPU / 1024 / TIMER_FREQ) <= 256
+	#define  PRESCALE       1024
+	#define  CLOCK_SELECT  ((1<<CS02)|(1<<CS00))
+#else
+	#error "TIMER_FREQ is too low"
+#endif
+
+// ----------------------------------------------------------------------------
+
+static volatile uint16_t _timer_ticks;
+
+// ----------------------------------------------------------------------------
+
+ISR(TIMER0_COMPA_vect) {
+	_timer_ticks++;
+}
+
+// ----------------------------------------------------------------------------
+
+void timer_init(void) {
+	TCCR0A = (1<<WGM01);    // CTC mode: count up to OCR0A, then clear
+	TCCR0B = CLOCK_SELECT;  // start the timer
+	OCR0A  = (F_CPU / PRESCALE / TIMER_FREQ) - 1;
+	TIMSK0 = (1<<OCIE0A);   // interrupt on compare match
+}
+
+/*
+ * Returns
+ * - the number of ticks since `timer_init()` was called, mod 2^16
+ */
+uint16_t timer_get_ticks(void) {
+	uint16_t ticks;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ticks = _timer_ticks;
+	}
+	return ticks;
+}
+
+/*
+ * Returns
+ * - the tick count, as soon as it's something other than `tick`
+ */
+uint16_t timer_wait_next(uint16_t tick) {
+	uint16_t ticks;
+	while ((ticks = timer_get_ticks()) == tick);
+	return ticks;
+}
+
+
+// ----------------------------------------------------------------------------
+#endif
+// ----------------------------------------------------------------------------
+
@@ -0,0 +1,28 @@
+/* ----------------------------------------------------------------------------
+ * Very simple Teensy 2.0 timer library : exports
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#ifndef TIMER_h
+	#define TIMER_h
+
+	#include <stdint.h>
+
+	// --------------------------------------------------------------------
+
+	#ifndef TIMER_FREQ
+		#define TIMER_FREQ MAKEFILE_SCAN_RATE  // in Hz
+	#endif
+
+	// --------------------------------------------------------------------
+
+	void     timer_init      (void);
+	uint16_t timer_get_ticks (void);
+	uint16_t timer_wait_next (uint16_t tick);
+
+#endif
+
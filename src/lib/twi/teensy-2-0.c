@@ -3,6 +3,8 @@
  *
  * - This is mostly straight from the datasheet, section 20.6.6, figure 20-11
  *   (the code example in C), and section 20.8.1, figure 20-12
+ * - The background (interrupt driven) transactions follow the state diagrams
+ *   in sections 20.8.1 (master transmitter) and 20.8.2 (master receiver)
  * - Also see the documentation for `<util/twi.h>` at
  *   <http://www.nongnu.org/avr-libc/user-manual/group__util__twi.html#ga8d3aca0acc182f459a51797321728168>
  *
@@ -27,11 +29,96 @@
 // ----------------------------------------------------------------------------
 
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <util/delay.h>
 #include <util/twi.h>
 #include "./teensy-2-0.h"
 
 // ----------------------------------------------------------------------------
 
+#define QUEUE_MASK (TWI_QUEUE_SIZE-1)
+#if TWI_QUEUE_SIZE & QUEUE_MASK
+	#error "`TWI_QUEUE_SIZE` must be a power of 2"
+#endif
+
+// TWCR values for the interrupt driven transactions
+#define TWCR_START ( (1<<TWINT)|(1<<TWEN)|(1<<TWIE)|(1<<TWSTA) )
+#define TWCR_NEXT  ( (1<<TWINT)|(1<<TWEN)|(1<<TWIE) )
+#define TWCR_ACK   ( (1<<TWINT)|(1<<TWEN)|(1<<TWIE)|(1<<TWEA) )
+#define TWCR_STOP  ( (1<<TWINT)|(1<<TWEN)|(1<<TWSTO) )
+
+// ----------------------------------------------------------------------------
+
+// pins (port D) used by TWI, for `twi_recover()`
+#define SCL 0
+#define SDA 1
+
+// ----------------------------------------------------------------------------
+
+// whether a blocking function has timed out since the last `twi_stop()`
+// - once one has, the rest return right away (with `TWI_TIMED_OUT`) until
+//   `twi_stop()` recovers the bus, so a stuck bus costs at most one timeout
+//   per transaction
+static bool _timed_out;
+
+// queue of transactions to run in the background
+// - the head and tail counters run freely; `tail - head` is the number of
+//   queued transactions, and the one at `head` is the one in progress
+// - `_index` is the index of the next byte to write (or read) in the current
+//   transaction
+static struct twi_transaction * volatile _queue[TWI_QUEUE_SIZE];
+static volatile uint8_t _head, _tail;
+static uint8_t          _index;
+
+// ----------------------------------------------------------------------------
+
+/* wait (a bounded amount of time) for the hardware to set TWINT
+ *
+ * returns
+ * - success: 0
+ * - failure: `TWI_TIMED_OUT`
+ */
+static uint8_t _wait(void) {
+	for (uint16_t i=TWI_TIMEOUT; i; i--)
+		if (TWCR & (1<<TWINT))
+			return 0;
+
+	_timed_out = true;
+	return TWI_TIMED_OUT;
+}
+
+/* returns
+ * - the TWI status code, as an error (for when it isn't one we expected)
+ *
+ * notes
+ * - a bus error is `TW_BUS_ERROR` (0x00) in TWSR, so it's returned as
+ *   `TWI_BUS_ERROR` instead; otherwise it would look like success
+ */
+static uint8_t _error(void) {
+	uint8_t status = TW_STATUS;
+	return (status == TW_BUS_ERROR) ? TWI_BUS_ERROR : status;
+}
+
+/* wait (a bounded amount of time) for a STOP to finish
+ *
+ * returns
+ * - success: 0
+ * - failure: `TWI_TIMED_OUT`
+ */
+static uint8_t _wait_stop(void) {
+	for (uint16_t i=TWI_TIMEOUT; i; i--)
+		if (!(TWCR & (1<<TWSTO)))
+			return 0;
+
+	return TWI_TIMED_OUT;
+}
+
+// ----------------------------------------------------------------------------
+
 void twi_init(void) {
 	// set the prescaler value to 0
 	TWSR &= ~( (1<<TWPS1)|(1<<TWPS0) );
@@ -42,14 +129,17 @@ void twi_init(void) {
 }
 
 uint8_t twi_start(void) {
+	if (_timed_out)
+		return TWI_TIMED_OUT;
 	// send start
 	TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWSTA);
 	// wait for transmission to complete
-	while (!(TWCR & (1<<TWINT)));
+	if (_wait())
+		return TWI_TIMED_OUT;
 	// if it didn't work, return the status code (else return 0)
 	if ( (TW_STATUS != TW_START) &&
 	     (TW_STATUS != TW_REP_START) )
-		return TW_STATUS;  // error
+		return _error();  // error
 	return 0;  // success
 }
 
@@ -57,38 +147,243 @@ void twi_stop(void) {
 	// send stop
 	TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWSTO);
 	// wait for transmission to complete
-	while (TWCR & (1<<TWSTO));
+	// - if anything in this transaction timed out, or the stop does, the
+	//   bus is probably stuck
+	if (_wait_stop() || _timed_out)
+		twi_recover();
 }
 
 uint8_t twi_send(uint8_t data) {
+	if (_timed_out)
+		return TWI_TIMED_OUT;
 	// load data into the data register
 	TWDR = data;
 	// send data
 	TWCR = (1<<TWINT)|(1<<TWEN);
 	// wait for transmission to complete
-	while (!(TWCR & (1<<TWINT)));
+	if (_wait())
+		return TWI_TIMED_OUT;
 	// if it didn't work, return the status code (else return 0)
 	if ( (TW_STATUS != TW_MT_SLA_ACK)  &&
 	     (TW_STATUS != TW_MT_DATA_ACK) &&
 	     (TW_STATUS != TW_MR_SLA_ACK) )
-		return TW_STATUS;  // error
+		return _error();  // error
 	return 0;  // success
 }
 
 uint8_t twi_read(uint8_t * data) {
+	if (_timed_out)
+		return TWI_TIMED_OUT;
 	// read 1 byte to TWDR, send ACK
 	TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWEA);
 	// wait for transmission to complete
-	while (!(TWCR & (1<<TWINT)));
+	if (_wait())
+		return TWI_TIMED_OUT;
 	// set data variable
 	*data = TWDR;
 	// if it didn't work, return the status code (else return 0)
 	if (TW_STATUS != TW_MR_DATA_ACK)
-		return TW_STATUS;  // error
+		return _error();  // error
 	return 0;  // success
 }
 
 
+// ----------------------------------------------------------------------------
+// background transactions
+// - the blocking functions above must not be used while `twi_busy()`
+// ----------------------------------------------------------------------------
+
+/* finish the current transaction with `status`, and go on to the next one
+ * (or stop, if there isn't one)
+ *
+ * - `status` must be 0 only if the transaction succeeded
+ * - if another transaction is queued, setting TWSTA and TWSTO together sends
+ *   a STOP followed by a START (datasheet section 20.9.2)
+ * - after a bus error, setting TWSTO (and clearing TWINT) is also what
+ *   releases the bus: the hardware goes back to the not addressed slave
+ *   state without sending anything (datasheet section 20.8.5)
+ */
+static void _finish(uint8_t status) {
+	_queue[_head & QUEUE_MASK]->status = status;
+	_head++;
+	_index = 0;
+
+	if (_head != _tail)
+		TWCR = TWCR_START | (1<<TWSTO);
+	else
+		TWCR = TWCR_STOP;
+}
+
+ISR(TWI_vect) {
+	struct twi_transaction * t = _queue[_head & QUEUE_MASK];
+
+	switch (TW_STATUS) {
+		// start sent: address the slave
+		case TW_START:
+			if (t->write_length)
+				TWDR = (t->address<<1) | TW_WRITE;
+			else
+				TWDR = (t->address<<1) | TW_READ;
+			TWCR = TWCR_NEXT;
+			break;
+
+		// repeated start sent: address the slave for reading
+		case TW_REP_START:
+			TWDR = (t->address<<1) | TW_READ;
+			TWCR = TWCR_NEXT;
+			break;
+
+		// address or data sent: send more, switch to reading, or stop
+		case TW_MT_SLA_ACK:
+		case TW_MT_DATA_ACK:
+			if (_index < t->write_length) {
+				TWDR = t->write_data[_index++];
+				TWCR = TWCR_NEXT;
+			} else if (t->read_length) {
+				_index = 0;
+				TWCR = TWCR_START;
+			} else {
+				_finish(0);
+			}
+			break;
+
+		// data received: keep it, then ask for more (below)
+		case TW_MR_DATA_ACK:
+			t->read_data[_index++] = TWDR;
+			// fall through
+		// address sent: ask for data (NACK the last byte)
+		case TW_MR_SLA_ACK:
+			if (_index+1 < t->read_length)
+				TWCR = TWCR_ACK;
+			else
+				TWCR = TWCR_NEXT;
+			break;
+
+		// last byte received
+		case TW_MR_DATA_NACK:
+			t->read_data[_index] = TWDR;
+			_finish(0);
+			break;
+
+		// anything else is an error (NACK, arbitration lost, bus error)
+		// - never finish with 0 here: a bus error is 0x00 in TWSR
+		default:
+			_finish(_error());
+			break;
+	}
+}
+
+/* returns
+ * - success: 0
+ * - failure: 1 (the queue is full)
+ *
+ * notes
+ * - the transaction is started right away if the bus is free, else after the
+ *   ones before it are done
+ */
+uint8_t twi_queue(struct twi_transaction * transaction) {
+	uint8_t ret = 0;
+
+	transaction->status = TWI_PENDING;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if ((uint8_t)(_tail - _head) >= TWI_QUEUE_SIZE) {
+			ret = 1;
+		} else {
+			_queue[_tail & QUEUE_MASK] = transaction;
+			if (_tail++ == _head) {
+				// wait for the last STOP (if any) to finish, then START
+				// - if it doesn't, `twi_wait()` will time out, and
+				//   recover the bus
+				_wait_stop();
+				_index = 0;
+				TWCR = TWCR_START;
+			}
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Returns
+ * - whether there are transactions that haven't finished yet
+ */
+bool twi_busy(void) {
+	return _head != _tail;
+}
+
+/* wait for all queued transactions to finish (and the bus to be free)
+ *
+ * returns
+ * - success: 0
+ * - failure: `TWI_TIMED_OUT` (the bus was recovered, and the transactions
+ *   that hadn't finished were given this status)
+ *
+ * notes
+ * - the timeout is per transaction: we give up if the one in progress takes
+ *   more than `TWI_TIMEOUT` loop iterations
+ */
+uint8_t twi_wait(void) {
+	uint8_t  head = _head;
+	uint16_t i = TWI_TIMEOUT;
+
+	while (_head != _tail) {
+		if (head != _head) {
+			head = _head;
+			i = TWI_TIMEOUT;
+		} else if (! --i) {
+			twi_recover();
+			return TWI_TIMED_OUT;
+		}
+	}
+
+	if (_wait_stop()) {
+		twi_recover();
+		return TWI_TIMED_OUT;
+	}
+
+	return 0;
+}
+
+/* release a stuck bus, and start over
+ *
+ * - a slave that was interrupted partway through sending a byte (e.g. by a
+ *   glitch on the cable) can hold SDA low forever, waiting for more clocks;
+ *   so we take the pins away from the TWI hardware, clock SCL until the slave
+ *   lets go of SDA (9 clocks at most), send a STOP by hand, and re-initialize
+ * - "high" is hi-Z (the lines have external pull-ups), and "low" is output
+ *   low, like the TWI hardware does it
+ * - any queued transactions are dropped, with status `TWI_TIMED_OUT`
+ */
+void twi_recover(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TWCR = 0;  // disable TWI (and its interrupt)
+
+		for (; _head != _tail; _head++)
+			_queue[_head & QUEUE_MASK]->status = TWI_TIMED_OUT;
+		_index = 0;
+	}
+
+	DDRD  &= ~( (1<<SCL)|(1<<SDA) );  // SCL and SDA hi-Z
+	PORTD &= ~( (1<<SCL)|(1<<SDA) );  // (pull-ups off, so output is low)
+
+	for (uint8_t i=0; i<9 && !(PIND & (1<<SDA)); i++) {
+		DDRD |=  (1<<SCL); _delay_us(5);  // SCL low
+		DDRD &= ~(1<<SCL); _delay_us(5);  // SCL high
+	}
+
+	// STOP: SDA low to high, while SCL is high
+	DDRD |=  (1<<SCL); _delay_us(5);  // SCL low
+	DDRD |=  (1<<SDA); _delay_us(5);  // SDA low
+	DDRD &= ~(1<<SCL); _delay_us(5);  // SCL high
+	DDRD &= ~(1<<SDA); _delay_us(5);  // SDA high
+
+	twi_init();
+	_timed_out = false;
+}
+
+
 // ----------------------------------------------------------------------------
 #endif
 // ----------------------------------------------------------------------------
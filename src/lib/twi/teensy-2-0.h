@@ -10,12 +10,67 @@
 #ifndef TWI_h
 	#define TWI_h
 
+	#include <stdbool.h>
+	#include <stdint.h>
+
 	// --------------------------------------------------------------------
 
 	#ifndef TWI_FREQ
-		#define TWI_FREQ 100000  // in Hz
+		#define TWI_FREQ MAKEFILE_TWI_FREQ  // in Hz
 	#endif
 
+	// how long to wait for the TWI hardware before giving up, in loop
+	// iterations
+	// - each iteration is a few cycles, so this is roughly 1ms at 16MHz,
+	//   which is more than 10 byte times at 100kHz
+	#define TWI_TIMEOUT 2000
+
+	// --------------------------------------------------------------------
+
+	// status of a transaction that hasn't finished yet
+	// - TWI status codes always have the low 3 bits clear (see
+	//   `<util/twi.h>`), so this can't be confused with one
+	#define TWI_PENDING 0x01
+
+	// status returned when the TWI hardware doesn't finish in time (also
+	// can't be confused with a TWI status code)
+	#define TWI_TIMED_OUT 0x02
+
+	// status returned for a bus error (an illegal START or STOP, e.g. when
+	// the cable is unplugged partway through a transfer)
+	// - the hardware's code for this (`TW_BUS_ERROR`) is 0x00, which would
+	//   look like success; 0 only ever means success here
+	#define TWI_BUS_ERROR 0x03
+
+	// maximum number of transactions that can be queued at once
+	#define TWI_QUEUE_SIZE 8
+
+	/*
+	 * a transaction, to be run in the background by the TWI interrupt
+	 *
+	 * this is
+	 *     S SLA+W write_data[0] ... write_data[write_length-1]
+	 *     Sr SLA+R read_data[0] ... read_data[read_length-1] P
+	 * where the write part is skipped if `write_length` is 0, and the read
+	 * part is skipped if `read_length` is 0.  the last byte read is NACKed.
+	 *
+	 * - `address`: 7-bit slave address
+	 * - `status`: `TWI_PENDING` until the transaction is done, then 0 on
+	 *   success, or the TWI status code of whatever went wrong (never 0:
+	 *   a bus error is `TWI_BUS_ERROR`)
+	 *
+	 * at least one of `write_length` and `read_length` must be non-zero.  the
+	 * transaction, and both buffers, must stay valid until it's done
+	 */
+	struct twi_transaction {
+		uint8_t             address;
+		uint8_t             write_length;
+		uint8_t *           write_data;
+		uint8_t             read_length;
+		uint8_t *           read_data;
+		volatile uint8_t    status;
+	};
+
 	// --------------------------------------------------------------------
 
 	void    twi_init  (void);
@@ -24,5 +79,11 @@
 	uint8_t twi_send  (uint8_t data);
 	uint8_t twi_read  (uint8_t * data);
 
+	uint8_t twi_queue (struct twi_transaction * transaction);
+	bool    twi_busy  (void);
+	uint8_t twi_wait  (void);
+
+	void    twi_recover (void);
+
 #endif
 
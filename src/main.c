@@ -13,6 +13,10 @@
 #include <util/delay.h>
 #include "./lib-other/pjrc/usb_keyboard/usb_keyboard.h"
 #include "./lib/key-functions/public.h"
+#include "./lib/debounce.h"
+#include "./lib/key-queue.h"
+#include "./lib/profile.h"
+#include "./lib/timer.h"
 #include "./keyboard/controller.h"
 #include "./keyboard/layout.h"
 #include "./keyboard/matrix.h"
@@ -24,35 +28,94 @@
 
 // ----------------------------------------------------------------------------
 
-static bool _main_kb_is_pressed[KB_ROWS][KB_COLUMNS];
-bool (*main_kb_is_pressed)[KB_ROWS][KB_COLUMNS] = &_main_kb_is_pressed;
+#if KB_COLUMNS > 16
+	#error "Expecting at most 16 columns (one `uint16_t` per row)"
+#endif
 
-static bool _main_kb_was_pressed[KB_ROWS][KB_COLUMNS];
-bool (*main_kb_was_pressed)[KB_ROWS][KB_COLUMNS] = &_main_kb_was_pressed;
+static uint16_t main_kb_raw[KB_ROWS];
 
-static bool main_kb_was_transparent[KB_ROWS][KB_COLUMNS];
+uint16_t main_kb_is_pressed[KB_ROWS];  // the debounced matrix
+
+static uint16_t main_kb_was_transparent[KB_ROWS];
+
+// the state of each key as of the last event queued for it
+static uint16_t main_kb_queued[KB_ROWS];
+
+// bit `n` of `[layer][row]` is set if the press (or release) function of the
+// key in column `n` is `kbfun_transparent()`
+// - see `main_kb_transparent_update()`
+static uint16_t main_kb_transparent_press[KB_LAYERS][KB_ROWS];
+static uint16_t main_kb_transparent_release[KB_LAYERS][KB_ROWS];
+
+#if MAKEFILE_KEY_CACHE
+	// how each key resolved (through any transparent layers) the last time
+	// it was pressed from the top of the stack
+	// - only valid while `generation` matches `main_layers_generation`
+	//   (see `main_exec_key()`)
+	static struct {
+		uint8_t       generation;
+		uint8_t       layer_id;  // the element the key resolved to
+		uint8_t       hops;      // the number of transparent layers skipped
+		kbfun_funptr_t function;
+	} main_key_cache[KB_ROWS][KB_COLUMNS];
+
+	uint16_t main_key_cache_hits;
+	uint16_t main_key_cache_misses;
+#endif
 
 uint8_t main_layers_pressed[KB_ROWS][KB_COLUMNS];
 
+static uint16_t main_scan_tick;
+uint16_t main_scan_period;
+uint16_t main_scan_overruns;
+
 uint8_t main_loop_row;
 uint8_t main_loop_col;
 
-uint8_t main_arg_layer;
-uint8_t main_arg_layer_offset;
-uint8_t main_arg_row;
-uint8_t main_arg_col;
-bool    main_arg_is_pressed;
-bool    main_arg_was_pressed;
+struct key_event * main_key_event;
+
 bool    main_arg_any_non_trans_key_pressed;
-bool    main_arg_trans_key_pressed;
 
 // ----------------------------------------------------------------------------
 
+/*
+ * Queue changes
+ * - Queue an event (stamped with the current scan tick) for every key whose
+ *   debounced state differs from the last event queued for it.
+ * - Rows are compared all at once, and only the keys that changed are looked
+ *   at individually.
+ * - If the queue fills up, the rest of the keys are left as they are, to be
+ *   queued by a later scan (when they'll still differ).
+ */
+static void main_queue_changes(void) {
+	for (uint8_t row=0; row<KB_ROWS; row++) {
+		uint16_t changed = main_kb_is_pressed[row] ^ main_kb_queued[row];
+
+		for (uint8_t col=0; changed; col++, changed>>=1) {
+			if (changed & 1) {
+				uint16_t bit = (1<<col);
+				struct key_queue_entry entry = {
+					.row        = row,
+					.col        = col,
+					.is_pressed = main_kb_is_pressed[row] & bit,
+					.time       = main_scan_tick,
+				};
+
+				if (key_queue_push(&entry))
+					return;  // full (retried next scan; see
+					         // "lib/key-queue.h")
+				main_kb_queued[row] ^= bit;
+			}
+		}
+	}
+}
+
 /*
  * main()
  */
 int main(void) {
 	kb_init();  // does controller initialization too
+	main_kb_transparent_update();
 
 	kb_led_state_power_on();
 
@@ -62,15 +125,42 @@ int main(void) {
 
 	kb_led_state_ready();
 
-	for (;;) {
-		// swap `main_kb_is_pressed` and `main_kb_was_pressed`, then update
-		bool (*temp)[KB_ROWS][KB_COLUMNS] = main_kb_was_pressed;
-		main_kb_was_pressed = main_kb_is_pressed;
-		main_kb_is_pressed = temp;
+	timer_init();
+	main_scan_tick = timer_get_ticks();
 
-		kb_update_matrix(*main_kb_is_pressed);
+	profile_init();
 
-		// this loop is responsible to
+	for (;;) {
+		// wait for the next scan tick
+		// - scans happen at a fixed rate (`MAKEFILE_SCAN_RATE`),
+		//   independent of how long the rest of the loop takes
+		// - keep track of the period (in ticks) since the last scan, and
+		//   of how many ticks we've missed altogether, in case the loop
+		//   ever takes longer than a tick (debouncing counts the whole
+		//   period, so it keeps time either way)
+		uint16_t tick = timer_wait_next(main_scan_tick);
+		main_scan_period = tick - main_scan_tick;
+		main_scan_overruns += main_scan_period - 1;
+		main_scan_tick = tick;
+
+		profile_loop();
+
+		// update the matrix
+		// - what it was last time isn't needed: changes are found by
+		//   comparing against `main_kb_queued` instead
+		profile_enter(MAIN_PROFILE_UPDATE_MATRIX);
+		kb_update_matrix(main_kb_raw);
+		profile_exit(MAIN_PROFILE_UPDATE_MATRIX);
+		debounce_update( main_kb_raw, main_kb_is_pressed,
+		                 (main_scan_period > 255) ? 255
+		                                          : main_scan_period );
+
+		// scan stage: queue an event for each key that has changed
+		profile_enter(MAIN_PROFILE_QUEUE_CHANGES);
+		main_queue_changes();
+		profile_exit(MAIN_PROFILE_QUEUE_CHANGES);
+
+		// processing stage: this loop is responsible to
 		// - "execute" keys when they change state
 		// - keep track of which layers the keys were on when they were pressed
 		//   (so they can be released using the function from that layer)
@@ -80,45 +170,76 @@ int main(void) {
 		//   - see the keyboard layout file ("keyboard/ergodox/layout/*.c") for
 		//     which key is assigned which function (per layer)
 		//   - see "lib/key-functions/public/*.c" for the function definitions
-		#define row          main_loop_row
-		#define col          main_loop_col
-		#define layer        main_arg_layer
-		#define is_pressed   main_arg_is_pressed
-		#define was_pressed  main_arg_was_pressed
-		for (row=0; row<KB_ROWS; row++) {
-			for (col=0; col<KB_COLUMNS; col++) {
-				is_pressed = (*main_kb_is_pressed)[row][col];
-				was_pressed = (*main_kb_was_pressed)[row][col];
-
-				if (is_pressed != was_pressed) {
-					if (is_pressed) {
-						layer = main_layers_peek(0);
-						main_layers_pressed[row][col] = layer;
-						main_arg_trans_key_pressed = false;
-					} else {
-						layer = main_layers_pressed[row][col];
-						main_arg_trans_key_pressed = main_kb_was_transparent[row][col];
-					}
-
-					// set remaining vars, and "execute" key
-					main_arg_row          = row;
-					main_arg_col          = col;
-					main_arg_layer_offset = 0;
-					main_exec_key();
-					main_kb_was_transparent[row][col] = main_arg_trans_key_pressed;
-				}
+		// - if a scan comes due while we're working through the queue, we
+		//   stop (after at least one event, so we always make progress) and
+		//   pick up where we left off after the scan
+		profile_enter(MAIN_PROFILE_KEY_LOOP);
+		struct key_queue_entry entry;
+		while (! key_queue_pop(&entry)) {
+			uint8_t row = entry.row;
+			uint8_t col = entry.col;
+			uint16_t bit = (1<<col);
+			struct key_event event;
+
+			event.is_pressed = entry.is_pressed;
+			event.was_pressed = !event.is_pressed;
+
+			if (event.is_pressed) {
+				event.layer = main_layers_peek(0);
+				main_layers_pressed[row][col] = event.layer;
+				event.flags = 0;
+			} else {
+				event.layer = main_layers_pressed[row][col];
+				event.flags = ( (main_kb_was_transparent[row] & bit)
+				                ? KEY_EVENT_TRANSPARENT
+				                : 0 );
 			}
+
+			// set remaining vars, and "execute" key
+			// - transparent keys look down the stack from the top,
+			//   either way
+			event.row          = row;
+			event.col          = col;
+			event.layer_offset = 0;
+			event.layer_id     = main_layers_peek_id(0);
+			event.time         = entry.time;
+			main_loop_row      = row;
+			main_loop_col      = col;
+			profile_enter(MAIN_PROFILE_EXEC_KEY);
+			main_exec_key(&event);
+			profile_exit(MAIN_PROFILE_EXEC_KEY);
+			if (event.flags & KEY_EVENT_TRANSPARENT)
+				main_kb_was_transparent[row] |= bit;
+			else
+				main_kb_was_transparent[row] &= ~bit;
+
+			#if MAKEFILE_REPORT_PER_EVENT
+				// queue a report for each key as it's processed,
+				// so that (e.g.) a shift generated for one key
+				// can't be applied to another key pressed during
+				// the same scan
+				if (keyboard_report_changed) {
+					profile_enter(MAIN_PROFILE_USB_SEND);
+					usb_keyboard_send();
+					profile_exit(MAIN_PROFILE_USB_SEND);
+				}
+			#endif
+
+			if (timer_get_ticks() != main_scan_tick)
+				break;
 		}
-		#undef row
-		#undef col
-		#undef layer
-		#undef is_pressed
-		#undef was_pressed
-
-		// send the USB report (even if nothing's changed)
-		usb_keyboard_send();
+		profile_exit(MAIN_PROFILE_KEY_LOOP);
+
+		// send the USB reports (only if something's changed)
+		// - reports are queued, and go out in order as the host polls for
+		//   them, so this doesn't wait on the USB
+		// - resending an unchanged report when the host asks for that (the
+		//   idle rate) is taken care of by the SOF interrupt
+		profile_enter(MAIN_PROFILE_USB_SEND);
+		if (keyboard_report_changed)
+			usb_keyboard_send();
 		usb_extra_consumer_send();
-		_delay_ms(MAKEFILE_DEBOUNCE_TIME);
+		profile_exit(MAIN_PROFILE_USB_SEND);
 
 		// update LEDs
 		if (keyboard_leds & (1<<0)) { kb_led_num_on(); }
@@ -138,15 +259,6 @@ int main(void) {
 
 // ----------------------------------------------------------------------------
 
-// convenience macros (for the helper functions below)
-#define  layer        main_arg_layer
-#define  row          main_arg_row
-#define  col          main_arg_col
-#define  is_pressed   main_arg_is_pressed
-#define  was_pressed  main_arg_was_pressed
-
-// ----------------------------------------------------------------------------
-
 /* ----------------------------------------------------------------------------
  * Layer Functions
  * ----------------------------------------------------------------------------
@@ -154,41 +266,215 @@ int main(void) {
  * may appear in the stack more than once.  The base layer will always be
  * layer-0.  
  *
- * Implemented as a fixed size stack.
+ * Implemented as a doubly linked list threaded through a fixed size table of
+ * elements, indexed by id, with a bitmask of the ids in use: pushing, popping
+ * (by id), looking at the top, and finding the element below any other (for
+ * transparent keys) all take constant time.
  * ------------------------------------------------------------------------- */
 
 // ----------------------------------------------------------------------------
 
+#if MAX_ACTIVE_LAYERS > 32
+	#error "Expecting at most 32 active layers (one `uint32_t` of ids)"
+#endif
+
 struct layers {
 	uint8_t layer;
-	uint8_t id;
 	uint8_t sticky;
+	uint8_t below;  // id of the next element down (for the base: itself)
+	uint8_t above;  // id of the next element up (for the top: 0)
 };
 
 // ----------------------------------------------------------------------------
 
-struct layers layers[MAX_ACTIVE_LAYERS];
-uint8_t       layers_head = 0;
-uint8_t       layers_ids_in_use[MAX_ACTIVE_LAYERS] = {true};
+// the element with id 0 is the base layer, and is always in use
+static struct layers layers[MAX_ACTIVE_LAYERS];
+static uint32_t      layers_ids_in_use = 1;  // bit `id` set if `id` is in use
+static uint8_t       layers_top   = 0;       // id of the topmost element
+static uint8_t       layers_depth = 0;       // number of elements above the
+					     //   base
+
+#if MAKEFILE_KEY_CACHE
+	// bumped every time the stack (or anything else that affects how keys
+	// resolve) changes; never 0
+	static uint8_t main_layers_generation = 1;
+#endif
+
+/*
+ * Changed
+ * - Note that the way keys resolve may have changed, so that anything cached
+ *   (see `main_exec_key()`) is thrown away.
+ */
+static void main_layers_changed(void) {
+	#if MAKEFILE_KEY_CACHE
+		if (++main_layers_generation)
+			return;
+
+		// wrapped: clear the cache, so nothing old looks current
+		for (uint8_t r=0; r<KB_ROWS; r++)
+			for (uint8_t c=0; c<KB_COLUMNS; c++)
+				main_key_cache[r][c].generation = 0;
+		main_layers_generation = 1;
+	#endif
+}
+
+/*
+ * Transparent key update
+ * - Find which keys on which layers are transparent, for `main_exec_key()`.
+ *   Must be called before the first key is executed, and again whenever the
+ *   layout changes (if it's not all in Flash).
+ */
+void main_kb_transparent_update(void) {
+	main_layers_changed();
+
+	for (uint8_t l=0; l<KB_LAYERS; l++) {
+		for (uint8_t r=0; r<KB_ROWS; r++) {
+			uint16_t press = 0;
+			uint16_t release = 0;
+			for (uint8_t c=0; c<KB_COLUMNS; c++) {
+				if (kb_layout_press_get(l, r, c) == &kbfun_transparent)
+					press |= (uint16_t)1 << c;
+				if (kb_layout_release_get(l, r, c) == &kbfun_transparent)
+					release |= (uint16_t)1 << c;
+			}
+			main_kb_transparent_press[l][r] = press;
+			main_kb_transparent_release[l][r] = release;
+		}
+	}
+}
+
 
 /*
  * Exec key
- * - Execute the keypress or keyrelease function (if it exists) of the key at
- *   the current possition.
+ * - Execute the keypress or keyrelease function (if it exists) of the key
+ *   `event` is for.
+ * - `event->layer` and `event->layer_id` should be where to start looking
+ *   (the top of the stack, unless this is being called on behalf of a key
+ *   above); they're updated if the key turns out to be transparent.
  */
-void main_exec_key(void) {
-	void (*key_function)(void) =
-		( (is_pressed)
-		  ? kb_layout_press_get(layer, row, col)
-		  : kb_layout_release_get(layer, row, col) );
+void main_exec_key(struct key_event * event) {
+	uint8_t row = event->row;
+	uint8_t col = event->col;
+	kbfun_funptr_t key_function;
+
+	#if MAKEFILE_KEY_CACHE
+		// a key pressed from the top of the stack (not released, and not
+		// executed on behalf of a key above it) resolves the same way
+		// every time, until the stack changes
+		bool cacheable = event->is_pressed
+		              && event->layer_offset == 0
+		              && event->layer_id == layers_top;
+
+		if ( cacheable && main_key_cache[row][col].generation
+		                  == main_layers_generation ) {
+			main_key_cache_hits++;
+			if (main_key_cache[row][col].hops) {
+				event->flags |= KEY_EVENT_TRANSPARENT;
+				event->layer_offset = main_key_cache[row][col].hops;
+				event->layer_id = main_key_cache[row][col].layer_id;
+				event->layer = layers[event->layer_id].layer;
+				main_layers_pressed[row][col] = event->layer;
+			}
+			key_function = main_key_cache[row][col].function;
+		} else
+	#endif
+	{
+		// if the key is transparent, go straight to the first layer
+		// down the stack where it isn't, instead of going through
+		// `kbfun_transparent()` (and back here) once per layer
+		uint16_t (*transparent)[KB_ROWS] =
+			( (event->is_pressed)
+			  ? main_kb_transparent_press
+			  : main_kb_transparent_release );
+		while (transparent[event->layer][row] & ((uint16_t)1 << col)) {
+			// a transparent key on the base layer has nowhere to go
+			if (event->layer_id == 0 && event->layer == layers[0].layer)
+				return;
+
+			event->flags |= KEY_EVENT_TRANSPARENT;
+			event->layer_offset++;
+			event->layer_id = layers[event->layer_id].below;
+			event->layer = layers[event->layer_id].layer;
+			main_layers_pressed[row][col] = event->layer;
+		}
 
-	if (key_function)
-		(*key_function)();
+		key_function =
+			( (event->is_pressed)
+			  ? kb_layout_press_get(event->layer, row, col)
+			  : kb_layout_release_get(event->layer, row, col) );
+
+		#if MAKEFILE_KEY_CACHE
+			if (cacheable) {
+				main_key_cache_misses++;
+				main_key_cache[row][col].generation = main_layers_generation;
+				main_key_cache[row][col].layer_id = event->layer_id;
+				main_key_cache[row][col].hops = event->layer_offset;
+				main_key_cache[row][col].function = key_function;
+			}
+		#endif
+	}
+
+	if (key_function) {
+		// (key functions may call this again, e.g. to execute the key
+		// below them; so put back whatever was there before, which is
+		// NULL at the outermost call)
+		struct key_event * previous = main_key_event;
+		main_key_event = event;
+		(*key_function)(event);
+		main_key_event = previous;
+	}
 
 	// If the current layer is in the sticky once up state and a key defined
 	//  for this layer (a non-transparent key) was pressed, pop the layer
-	if (layers[layers_head].sticky == eStickyOnceUp && main_arg_any_non_trans_key_pressed)
-		main_layers_pop_id(layers_head);
+	if (layers[layers_top].sticky == eStickyOnceUp && main_arg_any_non_trans_key_pressed)
+		main_layers_pop_id(layers_top);
+}
+
+/*
+ * peek_id()
+ *
+ * Arguments
+ * - 'offset': the offset (down the stack) from the head element
+ *
+ * Returns
+ * - success: the id of the requested element (which may be 0)
+ * - failure: 0 (the base element's id) (out of bounds)
+ */
+uint8_t main_layers_peek_id(uint8_t offset) {
+	if (offset > layers_depth)
+		return 0;  // default, or error
+
+	uint8_t id = layers_top;
+	while (offset--)
+		id = layers[id].below;
+
+	return id;
+}
+
+/*
+ * below()
+ *
+ * Arguments
+ * - 'id': the id of an element in the stack
+ *
+ * Returns
+ * - the id of the element below it (or 0, for the base element)
+ */
+uint8_t main_layers_below(uint8_t id) {
+	return layers[id].below;
+}
+
+/*
+ * get_layer()
+ *
+ * Arguments
+ * - 'id': the id of an element in the stack
+ *
+ * Returns
+ * - the layer-number of the element
+ */
+uint8_t main_layers_get_layer(uint8_t id) {
+	return layers[id].layer;
 }
 
 /*
@@ -202,17 +488,11 @@ void main_exec_key(void) {
  * - failure: 0 (default) (out of bounds)
  */
 uint8_t main_layers_peek(uint8_t offset) {
-	if (offset <= layers_head)
-		return layers[layers_head - offset].layer;
-
-	return 0;  // default, or error
+	return layers[main_layers_peek_id(offset)].layer;
 }
 
 uint8_t main_layers_peek_sticky(uint8_t offset) {
-	if (offset <= layers_head)
-		return layers[layers_head - offset].sticky;
-
-	return 0;  // default, or error
+	return layers[main_layers_peek_id(offset)].sticky;
 }
 
 /*
@@ -226,20 +506,25 @@ uint8_t main_layers_peek_sticky(uint8_t offset) {
  * - failure: 0 (the stack was already full)
  */
 uint8_t main_layers_push(uint8_t layer, uint8_t sticky) {
-	// look for an available id
-	for (uint8_t id=1; id<MAX_ACTIVE_LAYERS; id++) {
-		// if one is found
-		if (layers_ids_in_use[id] == false) {
-			layers_ids_in_use[id] = true;
-			layers_head++;
-			layers[layers_head].layer = layer;
-			layers[layers_head].id = id;
-			layers[layers_head].sticky = sticky;
-			return id;
-		}
-	}
-
-	return 0;  // default, or error
+	// look for an available id (the lowest one)
+	uint32_t free = ~layers_ids_in_use
+	              & ( ((uint32_t)1 << (MAX_ACTIVE_LAYERS-1)) - 1 ) << 1;
+	if (! free)
+		return 0;  // default, or error
+
+	uint8_t id = __builtin_ctzl(free);
+
+	layers_ids_in_use |= (uint32_t)1 << id;
+	layers[id].layer  = layer;
+	layers[id].sticky = sticky;
+	layers[id].below  = layers_top;
+	layers[id].above  = 0;
+	layers[layers_top].above = id;
+	layers_top = id;
+	layers_depth++;
+	main_layers_changed();
+
+	return id;
 }
 
 /*
@@ -249,23 +534,25 @@ uint8_t main_layers_push(uint8_t layer, uint8_t sticky) {
  * - 'id': the id of the element to pop from the stack
  */
 void main_layers_pop_id(uint8_t id) {
-	// look for the element with the id we want to pop
-	for (uint8_t element=1; element<=layers_head; element++) {
-		// if we find it
-		if (layers[element].id == id) {
-			for(; element<layers_head; ++element) {
-				layers[element].layer = layers[element+1].layer;
-				layers[element].id = layers[element+1].id;
-			}
-			// reinitialize the topmost (now unused) slot
-			layers[layers_head].layer = 0;
-			layers[layers_head].id = 0;
-			// record keeping
-			layers_ids_in_use[id] = false;
-			layers_head--;
-			return;
-		}
-	}
+	// the base element can't be popped, and neither can one that isn't
+	// there
+	if ( id == 0 || id >= MAX_ACTIVE_LAYERS
+	     || ! (layers_ids_in_use & ((uint32_t)1 << id)) )
+		return;
+
+	uint8_t below = layers[id].below;
+	uint8_t above = layers[id].above;
+
+	layers[below].above = above;
+	if (above)
+		layers[above].below = below;
+	else
+		layers_top = below;
+
+	// record keeping
+	layers_ids_in_use &= ~((uint32_t)1 << id);
+	layers_depth--;
+	main_layers_changed();
 }
 
 /* ----------------------------------------------------------------------------
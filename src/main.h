@@ -16,6 +16,15 @@
 
 	// --------------------------------------------------------------------
 
+	// profiler slots (see "lib/profile.h")
+	#define MAIN_PROFILE_UPDATE_MATRIX  0  // `kb_update_matrix()`
+	#define MAIN_PROFILE_KEY_LOOP       1  // the loop over queued keys
+	#define MAIN_PROFILE_EXEC_KEY       2  // `main_exec_key()`, per key
+	#define MAIN_PROFILE_USB_SEND       3  // sending reports
+	#define MAIN_PROFILE_QUEUE_CHANGES  4  // `main_queue_changes()`
+
+	// --------------------------------------------------------------------
+
 	typedef enum StickyState
 	{
 		eStickyNone,
@@ -24,32 +33,79 @@
 		eStickyLock
 	} StickyState;
 
-	extern bool (*main_kb_is_pressed)[KB_ROWS][KB_COLUMNS];
-	extern bool (*main_kb_was_pressed)[KB_ROWS][KB_COLUMNS];
+	extern uint16_t main_kb_is_pressed[KB_ROWS];
 
 	extern uint8_t main_layers_pressed[KB_ROWS][KB_COLUMNS];
 
+	extern uint16_t main_scan_period;
+	extern uint16_t main_scan_overruns;
+
+	#if MAKEFILE_KEY_CACHE
+		extern uint16_t main_key_cache_hits;
+		extern uint16_t main_key_cache_misses;
+	#endif
+
+	// `key_event.flags`
+	#define KEY_EVENT_TRANSPARENT  (1<<0)  // the key was transparent on (at
+					       //   least) the top layer
+
+	/*
+	 * key event
+	 * - Everything a key function needs to know about the key it's being
+	 *   executed for.  Passed (by pointer) to `main_exec_key()`, and from
+	 *   there to the key function.
+	 */
+	struct key_event {
+		uint8_t  row;
+		uint8_t  col;
+		uint8_t  layer;         // the layer the key function is from
+		uint8_t  layer_offset;  // how far down the stack that layer is
+		uint8_t  layer_id;      // the id of that element of the stack
+		bool     is_pressed;
+		bool     was_pressed;
+		uint8_t  flags;         // `KEY_EVENT_...`
+		uint16_t time;          // when the key changed (in timer ticks)
+	};
+
 	extern uint8_t main_loop_row;
 	extern uint8_t main_loop_col;
 
-	extern uint8_t main_arg_layer;
-	extern uint8_t main_arg_layer_offset;
-	extern uint8_t main_arg_row;
-	extern uint8_t main_arg_col;
-	extern bool    main_arg_is_pressed;
-	extern bool    main_arg_was_pressed;
+	extern struct key_event * main_key_event;  // the event being executed
+						   //   (NULL between key
+						   //   functions)
+
 	extern bool    main_arg_any_non_trans_key_pressed;
-	extern bool    main_arg_trans_key_pressed;
+
+	// for key functions written before `struct key_event`: the fields of
+	// the event being executed, under their old names
+	// - these are only valid while a key function is being called by
+	//   `main_exec_key()` (or by something it called); anywhere else,
+	//   `main_key_event` is NULL
+	// - `main_arg_trans_key_pressed` is read only: set
+	//   `KEY_EVENT_TRANSPARENT` in `event->flags` instead
+	// - new code should use the `event` passed to it instead
+	#define  main_arg_layer         (main_key_event->layer)
+	#define  main_arg_layer_offset  (main_key_event->layer_offset)
+	#define  main_arg_layer_id      (main_key_event->layer_id)
+	#define  main_arg_row           (main_key_event->row)
+	#define  main_arg_col           (main_key_event->col)
+	#define  main_arg_is_pressed    (main_key_event->is_pressed)
+	#define  main_arg_was_pressed   (main_key_event->was_pressed)
+	#define  main_arg_trans_key_pressed  \
+		(main_key_event->flags & KEY_EVENT_TRANSPARENT)
 
 	// --------------------------------------------------------------------
 
-	void main_exec_key (void);
+	void main_exec_key              (struct key_event * event);
+	void main_kb_transparent_update (void);
 
 	uint8_t main_layers_peek          (uint8_t offset);
 	uint8_t main_layers_peek_sticky   (uint8_t offset);
+	uint8_t main_layers_peek_id       (uint8_t offset);
+	uint8_t main_layers_below         (uint8_t id);
+	uint8_t main_layers_get_layer     (uint8_t id);
 	uint8_t main_layers_push          (uint8_t layer, uint8_t sticky);
 	void    main_layers_pop_id        (uint8_t id);
-	uint8_t main_layers_get_offset_id (uint8_t id);
 
 
 #endif
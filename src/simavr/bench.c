@@ -0,0 +1,359 @@
+/* ----------------------------------------------------------------------------
+ * simavr benchmark : the simulator side
+ *
+ * - Runs the firmware built with "./firmware.c" in simavr (as an ATmega32U4
+ *   at `F_CPU`), and prints how many CPU cycles each profiler slot took per
+ *   call: min, max, and average, one line per slot (see "./readme.md").
+ * - The left hand's MCP23018 is stubbed on the TWI bus: it ACKs its address,
+ *   keeps its registers, and answers reads of GPIOB the way the real chip
+ *   would, given the columns driven low (through GPIOA) and the keys held
+ *   in the trace.
+ * - The Teensy's pins are all pulled high from outside, so no key on the
+ *   right hand is ever pressed.
+ * - The trace (on stdin) is in the format of the host build (see
+ *   "../host/readme.md"), but only events are allowed (no whole frames),
+ *   and only for keys on the left hand (columns 0..6).  Frame 0 is the
+ *   first scan; frame `n` starts `n` scan periods (`MAKEFILE_SCAN_RATE`)
+ *   later.  The run stops at the end of the trace.
+ * - Built with the host compiler, against simavr's library, by
+ *   `make simavr-bench`.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "avr_ioport.h"
+#include "avr_twi.h"
+
+// ----------------------------------------------------------------------------
+
+#define LINE_LENGTH 256
+
+#define KB_ROWS       6
+#define LEFT_COLUMNS  7
+
+// where the firmware writes profiler slot numbers (see "./firmware.c"), as
+// data space addresses, on the ATmega32U4
+#define GPIOR1_ADDRESS  0x4A  // entering a slot
+#define GPIOR2_ADDRESS  0x4B  // leaving a slot
+
+#define SLOTS  8  // (`PROFILE_SLOTS`, in "../lib/profile.h")
+
+// the name of each slot (see `MAIN_PROFILE_...` in "../main.h", and
+// "./firmware.c")
+static const char * slot_names[SLOTS] = {
+	"kb_update_matrix",
+	"key_loop",
+	"main_exec_key",
+	"report_send",
+	"main_queue_changes",
+	"usb_keyboard_send",
+};
+
+// the MCP23018 (see "../keyboard/ergodox/controller/mcp23018.c")
+#define MCP23018_TWI_ADDRESS  0x20
+#define IODIRA  0x00
+#define IOCON   0x0A
+#define GPIOA   0x12
+#define GPIOB   0x13
+#define OLATA   0x14
+#define MCP23018_REGISTERS  0x16
+
+// ----------------------------------------------------------------------------
+
+static avr_t * avr;
+
+// the keys held on the left hand: bit `col` of `[row]`
+static uint8_t _pressed[KB_ROWS];
+
+static struct {
+	avr_irq_t * irq;
+	uint8_t     registers[MCP23018_REGISTERS];
+	uint8_t     pointer;       // the register being read or written
+	bool        selected;      // addressed, since the last start
+	bool        have_pointer;  // the register address has been written
+} _mcp23018;
+
+static struct {
+	avr_cycle_count_t start;
+	avr_cycle_count_t min;
+	avr_cycle_count_t max;
+	avr_cycle_count_t total;
+	uint32_t          count;
+} _slots[SLOTS];
+
+static avr_cycle_count_t _first_scan;  // (0 until the first scan)
+
+// ----------------------------------------------------------------------------
+// the MCP23018
+// ----------------------------------------------------------------------------
+
+/* the value of GPIOB: a row reads low if a key in it is pressed, and the
+ * key's column is driven low (an output, set low)
+ */
+static uint8_t _mcp23018_rows(void) {
+	uint8_t driven = ~_mcp23018.registers[IODIRA]
+	               & ~_mcp23018.registers[OLATA];
+	uint8_t value = 0xFF;
+
+	for (uint8_t row=0; row<KB_ROWS; row++)
+		if (_pressed[row] & driven)
+			value &= ~(1<<(5-row));
+
+	return value;
+}
+
+/* move to the next register, the way the chip does in byte mode (IOCON.SEQOP
+ * set: toggle between the A and B register of a pair), or in sequential mode
+ */
+static void _mcp23018_next(void) {
+	if (_mcp23018.registers[IOCON] & (1<<5))
+		_mcp23018.pointer ^= 1;
+	else
+		_mcp23018.pointer = (_mcp23018.pointer + 1) % MCP23018_REGISTERS;
+}
+
+static void _mcp23018_hook(avr_irq_t * irq, uint32_t value, void * param) {
+	avr_twi_msg_irq_t msg;
+	msg.u.v = value;
+
+	if (msg.u.twi.msg & TWI_COND_STOP)
+		_mcp23018.selected = false;
+
+	if (msg.u.twi.msg & TWI_COND_START)
+		_mcp23018.selected = false;
+
+	if (msg.u.twi.msg & TWI_COND_ADDR) {
+		_mcp23018.selected =
+			(msg.u.twi.addr >> 1) == MCP23018_TWI_ADDRESS;
+		if (! _mcp23018.selected)
+			return;
+		if (! (msg.u.twi.addr & 1))  // write: the pointer comes next
+			_mcp23018.have_pointer = false;
+		avr_raise_irq( _mcp23018.irq + TWI_IRQ_INPUT,
+		               avr_twi_irq_msg( TWI_COND_ACK,
+		                                msg.u.twi.addr, 1 ) );
+		return;  // (the address isn't data, whatever else is set)
+	}
+
+	if (! _mcp23018.selected)
+		return;
+
+	if (msg.u.twi.msg & TWI_COND_WRITE) {
+		avr_raise_irq( _mcp23018.irq + TWI_IRQ_INPUT,
+		               avr_twi_irq_msg( TWI_COND_ACK,
+		                                msg.u.twi.addr, 1 ) );
+		if (! _mcp23018.have_pointer) {
+			_mcp23018.pointer = msg.u.twi.data % MCP23018_REGISTERS;
+			_mcp23018.have_pointer = true;
+		} else {
+			uint8_t reg = _mcp23018.pointer;
+			if (reg == GPIOA || reg == GPIOB)
+				reg += OLATA - GPIOA;  // (writing GPIO sets OLAT)
+			_mcp23018.registers[reg] = msg.u.twi.data;
+			_mcp23018_next();
+		}
+	}
+
+	if (msg.u.twi.msg & TWI_COND_READ) {
+		uint8_t data;
+		switch (_mcp23018.pointer) {
+			case GPIOA: data = _mcp23018.registers[OLATA]; break;
+			case GPIOB: data = _mcp23018_rows();           break;
+			default:    data = _mcp23018.registers[_mcp23018.pointer];
+		}
+		avr_raise_irq( _mcp23018.irq + TWI_IRQ_INPUT,
+		               avr_twi_irq_msg( TWI_COND_READ,
+		                                msg.u.twi.addr, data ) );
+		_mcp23018_next();
+	}
+}
+
+static void _mcp23018_init(void) {
+	static const char * names[] = { "twi.mcp23018.in", "twi.mcp23018.out" };
+
+	_mcp23018.irq = avr_alloc_irq(&avr->irq_pool, 0, 2, names);
+	avr_irq_register_notify( _mcp23018.irq + TWI_IRQ_OUTPUT,
+	                         _mcp23018_hook, NULL );
+
+	uint32_t twi = AVR_IOCTL_TWI_GETIRQ(0);
+	avr_connect_irq( _mcp23018.irq + TWI_IRQ_INPUT,
+	                 avr_io_getirq(avr, twi, TWI_IRQ_INPUT) );
+	avr_connect_irq( avr_io_getirq(avr, twi, TWI_IRQ_OUTPUT),
+	                 _mcp23018.irq + TWI_IRQ_OUTPUT );
+
+	// (the power on values)
+	_mcp23018.registers[IODIRA] = 0xFF;
+	_mcp23018.registers[IODIRA+1] = 0xFF;
+}
+
+// ----------------------------------------------------------------------------
+// the profiler slots
+// ----------------------------------------------------------------------------
+
+static void _slot_enter( avr_t * avr, avr_io_addr_t addr, uint8_t v,
+                         void * param ) {
+	if (v >= SLOTS)
+		return;
+	if (! _first_scan)
+		_first_scan = avr->cycle;
+	_slots[v].start = avr->cycle;
+}
+
+static void _slot_leave( avr_t * avr, avr_io_addr_t addr, uint8_t v,
+                         void * param ) {
+	if (v >= SLOTS || ! _slots[v].start)
+		return;
+
+	avr_cycle_count_t cycles = avr->cycle - _slots[v].start;
+	if (! _slots[v].count || cycles < _slots[v].min)
+		_slots[v].min = cycles;
+	if (cycles > _slots[v].max)
+		_slots[v].max = cycles;
+	_slots[v].total += cycles;
+	_slots[v].count++;
+	_slots[v].start = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+/* run until `frame` (counting scan periods from the first scan)
+ *
+ * returns
+ * - success: 0
+ * - failure: 1 (the simulation stopped)
+ */
+static uint8_t _run_until(uint32_t frame) {
+	const avr_cycle_count_t period = F_CPU / MAKEFILE_SCAN_RATE;
+
+	for (;;) {
+		if ( _first_scan
+		     && avr->cycle >= _first_scan + (avr_cycle_count_t)frame*period )
+			return 0;
+
+		int state = avr_run(avr);
+		if (state == cpu_Done || state == cpu_Crashed) {
+			fprintf(stderr, "error: the simulation stopped\n");
+			return 1;
+		}
+	}
+}
+
+static void _print(const char * trace) {
+	printf( "# cycles per call, ATmega32U4 at %lu Hz (simavr), %s\n",
+	        (unsigned long)F_CPU, trace );
+	printf( "%-20s %8s %8s %8s %8s\n",
+	        "# slot", "count", "min", "max", "avg" );
+	for (uint8_t slot=0; slot<SLOTS; slot++) {
+		if (! slot_names[slot])
+			continue;
+		if (! _slots[slot].count) {
+			printf( "%-20s %8u %8s %8s %8s\n",
+			        slot_names[slot], 0, "-", "-", "-" );
+			continue;
+		}
+		printf( "%-20s %8lu %8llu %8llu %8llu\n",
+		        slot_names[slot],
+		        (unsigned long)_slots[slot].count,
+		        (unsigned long long)_slots[slot].min,
+		        (unsigned long long)_slots[slot].max,
+		        (unsigned long long)( _slots[slot].total
+		                              / _slots[slot].count ) );
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char * argv[]) {
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <firmware.elf> <name>  < trace\n",
+				argv[0]);
+		return 1;
+	}
+
+	elf_firmware_t firmware;
+	memset(&firmware, 0, sizeof(firmware));
+	if (elf_read_firmware(argv[1], &firmware)) {
+		fprintf(stderr, "error: can't read '%s'\n", argv[1]);
+		return 1;
+	}
+	strcpy(firmware.mmcu, "atmega32u4");
+	firmware.frequency = F_CPU;
+
+	avr = avr_make_mcu_by_name(firmware.mmcu);
+	if (! avr) {
+		fprintf(stderr, "error: simavr has no ATmega32U4\n");
+		return 1;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &firmware);
+
+	avr_register_io_write(avr, GPIOR1_ADDRESS, _slot_enter, NULL);
+	avr_register_io_write(avr, GPIOR2_ADDRESS, _slot_leave, NULL);
+
+	_mcp23018_init();
+
+	// pull every pin high (only the inputs are read from here)
+	for (const char * port="BCDEF"; *port; port++)
+		for (uint8_t pin=0; pin<8; pin++)
+			avr_raise_irq( avr_io_getirq( avr,
+			                              AVR_IOCTL_IOPORT_GETIRQ(*port),
+			                              pin ),
+			               1 );
+
+	// play the trace
+	char buffer[LINE_LENGTH];
+	uint32_t line = 0;
+	while (fgets(buffer, sizeof(buffer), stdin)) {
+		line++;
+
+		char * comment = strchr(buffer, '#');
+		if (comment)
+			*comment = '\0';
+
+		unsigned long frame;
+		char action;
+		unsigned row, col;
+		int fields = sscanf(buffer, " @%lu %c %x %x", &frame, &action,
+		                    &row, &col);
+		if (fields <= 0) {
+			char c;
+			if (sscanf(buffer, " %c", &c) != 1)
+				continue;  // (empty)
+		}
+
+		if ( ! (fields == 1 || fields == 4)
+		     || (fields == 4 && (action != 'p' && action != 'r'))
+		     || (fields == 4 && (row >= KB_ROWS || col >= LEFT_COLUMNS)) ) {
+			fprintf( stderr,
+			         "error: line %lu: expected '@<frame>', or "
+			         "'@<frame> p|r <row> <column>' (left hand "
+			         "only)\n", (unsigned long)line );
+			return 1;
+		}
+
+		if (_run_until(frame))
+			return 1;
+
+		if (fields == 4) {
+			if (action == 'p')
+				_pressed[row] |= (1<<col);
+			else
+				_pressed[row] &= ~(1<<col);
+		}
+	}
+
+	_print(argv[2]);
+
+	return 0;
+}
+
@@ -0,0 +1,64 @@
+/* ----------------------------------------------------------------------------
+ * simavr benchmark : the firmware side
+ *
+ * - Built into the firmware in place of "../main.c" (which is included here)
+ *   and the USB library (which is too), for running in simavr under
+ *   "./bench.c".  Everything else is the usual firmware, for the Teensy 2.0.
+ * - The profiler (see "../lib/profile.h") is replaced: entering a slot
+ *   writes its number to `GPIOR1`, and leaving it writes the number to
+ *   `GPIOR2`.  The simulator notes the cycle count at each write, so the
+ *   times are in CPU cycles, with no timer to wrap around, and no table in
+ *   SRAM.
+ * - USB: the host is never there, so `usb_init()` just marks the device as
+ *   configured, and reports are queued (and written to the endpoint, if
+ *   the simulated controller lets them be) by the real library.
+ *   `usb_keyboard_send()` gets a slot of its own.
+ * - The delay that gives the OS time to load drivers is left out.
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2012 Ben Blazak <benblazak.dev@gmail.com>
+ * Released under The MIT License (MIT) (see "license.md")
+ * Project located at <https://github.com/benblazak/ergodox-firmware>
+ * ------------------------------------------------------------------------- */
+
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "../lib/profile.h"
+
+// ----------------------------------------------------------------------------
+
+#define SIMAVR_PROFILE_USB_KEYBOARD_SEND  5  // (after the `MAIN_PROFILE_...`
+                                             //   slots, in "../main.h")
+
+#undef  profile_init
+#undef  profile_enter
+#undef  profile_exit
+#undef  profile_loop
+#define profile_init()
+#define profile_enter(slot)  (GPIOR1 = (slot))
+#define profile_exit(slot)   (GPIOR2 = (slot))
+#define profile_loop()
+
+// ----------------------------------------------------------------------------
+
+#include "../lib-other/pjrc/usb_keyboard/usb_keyboard.c"
+
+static void _usb_init(void) {
+	usb_configuration = 1;
+}
+
+static int8_t _usb_keyboard_send(void) {
+	profile_enter(SIMAVR_PROFILE_USB_KEYBOARD_SEND);
+	int8_t ret = usb_keyboard_send();
+	profile_exit(SIMAVR_PROFILE_USB_KEYBOARD_SEND);
+	return ret;
+}
+
+#define usb_init                _usb_init
+#define usb_keyboard_send       _usb_keyboard_send
+#define kb_led_delay_usb_init()
+
+// ----------------------------------------------------------------------------
+
+#include "../main.c"
+